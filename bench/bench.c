@@ -0,0 +1,72 @@
+/*
+ * \file bench.c
+ * \brief
+ *    Host micro-benchmarks of usys. Each line reports the cost per
+ *    operation, and for the byte oriented ones the throughput, so the
+ *    output can be compared between releases.
+ *
+ *    usage: usys_bench [scale]
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <bench.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint32_t bench_scale = 1;
+
+/*!
+ * \brief
+ *    Host monotonic time in nanoseconds
+ */
+uint64_t bench_ns (void)
+{
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*!
+ * \brief
+ *    Print one result line
+ * \param   name  Benchmark name
+ * \param   ns    Elapsed nanoseconds
+ * \param   ops   Number of operations
+ * \param   bytes Number of bytes, 0 if not a throughput benchmark
+ */
+void bench_report (const char *name, uint64_t ns, uint64_t ops, uint64_t bytes)
+{
+   printf ("%-32s %10.2f ns/op", name, (ops) ? (double)ns / ops : 0.0);
+   if (bytes && ns)
+      printf (" %10.2f MB/s", (double)bytes * 1000.0 / ns);
+   printf ("\n");
+}
+
+int main (int argc, char *argv[])
+{
+   if (argc > 1 && atoi (argv[1]) > 0)
+      bench_scale = (uint32_t)atoi (argv[1]);
+
+   bench_cron ();
+   bench_heap ();
+   bench_write ();
+   bench_trace ();
+   return 0;
+}
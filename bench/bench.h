@@ -0,0 +1,42 @@
+/*
+ * \file bench.h
+ * \brief
+ *    Host micro-benchmarks of usys
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __bench_h__
+#define __bench_h__
+
+#include <usys_sim.h>
+
+/*!
+ * Scale of the iteration counts, from the command line
+ */
+extern uint32_t bench_scale;
+
+uint64_t bench_ns (void);
+void bench_report (const char *name, uint64_t ns, uint64_t ops, uint64_t bytes);
+
+void bench_cron (void);
+void bench_heap (void);
+void bench_write (void);
+void bench_trace (void);
+
+#endif // #ifndef __bench_h__
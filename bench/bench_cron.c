@@ -0,0 +1,124 @@
+/*
+ * \file bench_cron.c
+ * \brief
+ *    SysTick_Callback() and SysTick_Advance() cost against the number of
+ *    registered services, and the inlined USYS_SYSTICK_HANDLER() on a
+ *    sparse service set
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <bench.h>
+#include <stdio.h>
+
+#define  _TICKS      (1000000UL)
+
+static volatile uint32_t _hits;
+static void _srv (void) { ++_hits; }
+
+// The inlined tick handler, called through a pointer as from the vector table
+#undef   USYS_SYSTICK_VECTOR
+#define  USYS_SYSTICK_VECTOR  bench_systick_handler
+void bench_systick_handler (void);
+USYS_SYSTICK_HANDLER ();
+static void (* volatile _vector) (void) = bench_systick_handler;
+
+/*!
+ * \brief
+ *    Register \a n services with periods from 1 to 100 ticks
+ */
+static void _add (uint32_t n)
+{
+   uint32_t i;
+   for (i=0 ; i<n ; ++i)
+      service_add (_srv, 1 + (i * 37) % 100);
+}
+
+/*!
+ * \brief
+ *    Remove all the services and let the ISR apply it
+ */
+static void _rem (void)
+{
+   service_rem (_srv);
+   SysTick_Callback ();
+}
+
+void bench_cron (void)
+{
+   static const uint32_t n[] = { 0, 1, 4, 16, 64, 128, USYS_CRONTAB_ENTRIES };
+   char name[40];
+   uint64_t t, ticks = _TICKS * bench_scale;
+   uint32_t i, k;
+
+   for (i=0 ; i<sizeof (n) / sizeof (n[0]) ; ++i) {
+      _add (n[i]);
+      t = bench_ns ();
+      for (k=0 ; k<ticks ; ++k)
+         SysTick_Callback ();
+      t = bench_ns () - t;
+      snprintf (name, sizeof (name), "tick/%u-services", (unsigned)n[i]);
+      bench_report (name, t, ticks, 0);
+
+      t = bench_ns ();
+      for (k=0 ; k<ticks / 100 ; ++k)
+         SysTick_Advance (100);
+      t = bench_ns () - t;
+      snprintf (name, sizeof (name), "advance100/%u-services", (unsigned)n[i]);
+      bench_report (name, t, ticks / 100, 0);
+      _rem ();
+   }
+
+   // A full table of long periods, the tick visits the entries that are
+   // not due yet in its bucket
+   for (i=0 ; i<USYS_CRONTAB_ENTRIES ; ++i)
+      service_add (_srv, 1000 + i * 7);
+   t = bench_ns ();
+   for (k=0 ; k<ticks ; ++k)
+      SysTick_Callback ();
+   t = bench_ns () - t;
+   snprintf (name, sizeof (name), "tick/%u-long-services", (unsigned)USYS_CRONTAB_ENTRIES);
+   bench_report (name, t, ticks, 0);
+   _rem ();
+
+   // A 10 kHz tick with services of 1 ms up to 1 s
+   for (i=0 ; i<4 ; ++i)
+      service_add (_srv, 10 * (1 << (i * 3)) + i);
+   t = bench_ns ();
+   for (k=0 ; k<ticks ; ++k)
+      SysTick_Callback ();
+   t = bench_ns () - t;
+   bench_report ("tick/sparse-4-services", t, ticks, 0);
+
+   t = bench_ns ();
+   for (k=0 ; k<ticks ; ++k)
+      _vector ();
+   t = bench_ns () - t;
+   bench_report ("handler/sparse-4-services", t, ticks, 0);
+
+   // The same handler with the next event due on every tick, so each tick
+   // takes the full scheduler path, as without the fast path
+   t = bench_ns ();
+   for (k=0 ; k<ticks ; ++k) {
+      __usys_tbase.due = __usys_tbase.mticks;
+      _vector ();
+   }
+   t = bench_ns () - t;
+   bench_report ("handler/sparse-4-services-full", t, ticks, 0);
+   _rem ();
+}
@@ -0,0 +1,82 @@
+/*
+ * \file bench_heap.c
+ * \brief
+ *    Allocator throughput: the usys heap against the host's malloc(), and
+ *    the object pools
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <bench.h>
+#include <stdlib.h>
+
+#define  _OPS        (1000000UL)
+#define  _LIVE       (64)     //!< Allocations kept alive, must be a power of 2
+
+typedef void *(*alloc_ft) (size_t);
+typedef void (*free_ft) (void *);
+
+USYS_POOL_DEF (_pool, 48, _LIVE);
+
+/*!
+ * \brief
+ *    Size of the i-th request, a fixed mix from 8 to 512 bytes
+ */
+static size_t _size (uint32_t i) {
+   return 8 + (i * 2654435761UL >> 23) % 505;
+}
+
+/*!
+ * \brief
+ *    Allocate and free \a ops blocks, keeping \ref _LIVE of them alive
+ */
+static void _churn (const char *name, alloc_ft a, free_ft f, uint64_t ops)
+{
+   void *live[_LIVE] = { 0 };
+   uint64_t t = bench_ns ();
+   uint32_t i;
+
+   for (i=0 ; i<ops ; ++i) {
+      f (live[i & (_LIVE-1)]);
+      live[i & (_LIVE-1)] = a (_size (i));
+   }
+   for (i=0 ; i<_LIVE ; ++i)
+      f (live[i]);
+   bench_report (name, bench_ns () - t, ops, 0);
+}
+
+void bench_heap (void)
+{
+   void *live[_LIVE] = { 0 };
+   uint64_t t, ops = _OPS * bench_scale;
+   uint32_t i;
+
+#if USYS_HEAP
+   _churn ("heap/usys_malloc+free", usys_malloc, usys_free, ops);
+#endif
+   _churn ("heap/host_malloc+free", malloc, free, ops);
+
+   t = bench_ns ();
+   for (i=0 ; i<ops ; ++i) {
+      usys_pool_free (&_pool, live[i & (_LIVE-1)]);
+      live[i & (_LIVE-1)] = usys_pool_alloc (&_pool);
+   }
+   for (i=0 ; i<_LIVE ; ++i)
+      usys_pool_free (&_pool, live[i]);
+   bench_report ("pool/alloc+free", bench_ns () - t, ops, 0);
+}
@@ -0,0 +1,51 @@
+/*
+ * \file bench_trace.c
+ * \brief
+ *    usys_trace() cost, alone and with a reader draining the ring
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <bench.h>
+#include <stdio.h>
+#include <usystrace.h>
+
+#define  _OPS        (16UL*1024*1024)
+
+void bench_trace (void)
+{
+#if USYS_TRACE
+   static usys_trace_rec_t buf[64];
+   uint64_t t, n, ops = _OPS * bench_scale;
+
+   t = bench_ns ();
+   for (n=0 ; n<ops ; ++n)
+      usys_trace (1, n);
+   t = bench_ns () - t;
+   bench_report ("trace/put", t, ops, 0);
+
+   t = bench_ns ();
+   for (n=0 ; n<ops ; ) {
+      usys_trace (1, n);
+      if (!(++n & 63))
+         usys_trace_read (buf, 64);
+   }
+   t = bench_ns () - t;
+   bench_report ("trace/put+read", t, ops, ops * sizeof (usys_trace_rec_t));
+#endif
+}
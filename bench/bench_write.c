@@ -0,0 +1,51 @@
+/*
+ * \file bench_write.c
+ * \brief
+ *    _write() throughput through the stdio TX ring, with an infinitely
+ *    fast transmitter, for different write sizes
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <bench.h>
+#include <stdio.h>
+
+#define  _BYTES      (64UL*1024*1024)
+
+extern int _write (int32_t file, uint8_t *ptr, int32_t len);
+
+void bench_write (void)
+{
+#if USYS_TX_RING_SIZE
+   static const uint32_t len[] = { 1, 16, 64, 256 };
+   static uint8_t buf[256];
+   char name[40];
+   uint64_t t, n, bytes = _BYTES * bench_scale;
+   uint32_t i;
+
+   for (i=0 ; i<sizeof (len) / sizeof (len[0]) ; ++i) {
+      usys_sim_tx_bytes = 0;
+      t = bench_ns ();
+      for (n=0 ; n<bytes ; n += len[i])
+         _write (1, buf, (int32_t)len[i]);
+      t = bench_ns () - t;
+      snprintf (name, sizeof (name), "write/%u-bytes", (unsigned)len[i]);
+      bench_report (name, t, bytes / len[i], usys_sim_tx_bytes);
+   }
+#endif
+}
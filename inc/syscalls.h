@@ -46,6 +46,255 @@ extern "C" {
 #include <sys/time.h>
 #include <sys/times.h>
 
+#include <usysring.h>
+
+/*
+ * ======= User defines =============
+ */
+
+/*
+ * Syscall backend modes. Each group of syscalls below selects one of them.
+ */
+#define USYS_SC_NONE              (0)   /*!< Not provided, see the note */
+#define USYS_SC_MINIMAL           (1)   /*!< Small strong implementations, enough for newlib's stdio */
+#define USYS_SC_RING              (2)   /*!< stdio only: the TX/RX ring backends */
+#define USYS_SC_WEAK              (3)   /*!< Weak stubs the application can override (the default) */
+
+/*!
+ * stdio syscalls: _write(), _read().
+ *    \arg USYS_SC_MINIMAL  _write() drops the data, _read() returns end of file.
+ *    \arg USYS_SC_RING     The \ref USYS_TX_RING_SIZE / \ref USYS_RX_RING_SIZE
+ *                          ring backends, minimal for a ring of size 0.
+ *    \arg USYS_SC_WEAK     Weak ring backends for the rings with a size, weak
+ *                          ENOSYS stubs otherwise.
+ * \note
+ *    With USYS_SC_NONE a group is left out. Then the newlib code that
+ *    needs it does not link, which shows what drags it in, unless the
+ *    application provides its own. The other modes, except USYS_SC_WEAK,
+ *    have no weak symbols, so an application definition is a link error.
+ */
+#ifndef USYS_SC_STDIO
+#define USYS_SC_STDIO             (USYS_SC_WEAK)
+#endif
+
+/*!
+ * File syscalls: _open(), _close(), _lseek(), _fstat(), _isatty(), _stat(),
+ * _link(), _unlink(), _symlink(), _readlink().
+ *    \arg USYS_SC_MINIMAL  All files are character devices (a terminal), so
+ *                          newlib line-buffers stdout with no file support.
+ *    \arg USYS_SC_WEAK     Weak ENOSYS stubs.
+ */
+#ifndef USYS_SC_FILE
+#define USYS_SC_FILE              (USYS_SC_WEAK)
+#endif
+
+/*!
+ * Process syscalls: _getpid(), _kill(), _fork(), _execve(), _wait(), _times().
+ *    \arg USYS_SC_MINIMAL  A single process with pid 1, the others fail.
+ *    \arg USYS_SC_WEAK     Weak ENOSYS stubs.
+ */
+#ifndef USYS_SC_PROC
+#define USYS_SC_PROC              (USYS_SC_WEAK)
+#endif
+
+/*!
+ * Time syscalls: _gettimeofday(), on top of usys_gettimeofday().
+ *    \arg USYS_SC_MINIMAL  Strong.
+ *    \arg USYS_SC_WEAK     Weak.
+ */
+#ifndef USYS_SC_TIME
+#define USYS_SC_TIME              (USYS_SC_WEAK)
+#endif
+
+/*!
+ * stdio TX ring size. When not 0, usys provides a _write() that copies the
+ * data into the \ref usys_tx ring and returns. The port provides
+ * usys_tx_kick() to start draining the ring (from the TX ISR or a DMA) when
+ * the transmitter is idle.
+ * \note
+ *    Must be 0 or a power of 2
+ */
+#ifndef USYS_TX_RING_SIZE
+#define USYS_TX_RING_SIZE         (0)
+#endif
+
+#define USYS_TX_DROP              (0)   /*!< Drop what does not fit and return */
+#define USYS_TX_BLOCK             (1)   /*!< Wait for the ring to drain. Not from ISR */
+
+/*!
+ * _write() policy when the TX ring is full
+ */
+#ifndef USYS_TX_POLICY
+#define USYS_TX_POLICY            (USYS_TX_DROP)
+#endif
+
+/*!
+ * stdio RX ring size. When not 0, usys provides a _read() that copies the
+ * data out of the \ref usys_rx ring. The port's RX ISR (or circular DMA)
+ * fills the ring, see usys_ring_write() and usys_ring_dma_pos().
+ * \note
+ *    Must be 0 or a power of 2
+ */
+#ifndef USYS_RX_RING_SIZE
+#define USYS_RX_RING_SIZE         (0)
+#endif
+
+/*!
+ * Minimum space in bytes _sbrk() leaves between the heap and the stack
+ * pointer, when the linker does not provide a _heap_end symbol.
+ */
+#ifndef USYS_STACK_MARGIN
+#define USYS_STACK_MARGIN         (256)
+#endif
+
+/*!
+ * usys heap. When enabled, usys replaces newlib's allocator hooks
+ * (_malloc_r, _free_r, _realloc_r, _calloc_r) with a segregated fit
+ * allocator on top of _sbrk(). Each size class has its own free list, so
+ * alloc and free are O(1) and freed blocks are reused by the same class.
+ */
+#ifndef USYS_HEAP
+#define USYS_HEAP                 (0)
+#endif
+
+/*!
+ * Number of power of 2 size classes of the usys heap, starting from 8 bytes.
+ * The default (9) covers up to 2048 bytes. Larger requests use a first fit
+ * list.
+ */
+#ifndef USYS_HEAP_CLASSES
+#define USYS_HEAP_CLASSES         (9)
+#endif
+
+/*!
+ * Stack and heap watermark monitor. usys_memmon_init() paints the free RAM
+ * between the heap and the stack, and a cron service checks a few words of
+ * it per run to track how deep the stack and how high the heap have been,
+ * see usys_memmon_report().
+ */
+#ifndef USYS_MEMMON
+#define USYS_MEMMON               (0)
+#endif
+
+/*!
+ * Words the monitor checks per run
+ */
+#ifndef USYS_MEMMON_WORDS
+#define USYS_MEMMON_WORDS         (16)
+#endif
+
+/*!
+ * Ticks between the monitor runs
+ */
+#ifndef USYS_MEMMON_PERIOD
+#define USYS_MEMMON_PERIOD        (1)
+#endif
+
+/*!
+ * Paint pattern of the free RAM
+ */
+#ifndef USYS_MEMMON_PATTERN
+#define USYS_MEMMON_PATTERN       (0xA5A5A5A5UL)
+#endif
+
+/*!
+ * Host simulation build. The host's libc owns errno, environ, _exit() and
+ * the allocator lock, and the heap of _sbrk() is a static array of
+ * \ref USYS_SIM_HEAP_SIZE bytes instead of the area after _ebss.
+ */
+#ifndef USYS_SIM
+#define USYS_SIM                  (0)
+#endif
+
+/*!
+ * Heap size of the host simulation build, see \ref USYS_SIM
+ */
+#ifndef USYS_SIM_HEAP_SIZE
+#define USYS_SIM_HEAP_SIZE        (1024*1024)
+#endif
+
+/*
+ * ===== Ring backends ========
+ */
+#if USYS_TX_RING_SIZE
+#if (USYS_TX_RING_SIZE & (USYS_TX_RING_SIZE - 1))
+#error "USYS_TX_RING_SIZE must be a power of 2"
+#endif
+extern usys_ring_t usys_tx;                  /*!< stdio TX ring, the port is its consumer */
+extern volatile uint32_t usys_tx_dropped;    /*!< Bytes dropped by \ref USYS_TX_DROP */
+
+/*!
+ * From the port: start draining \ref usys_tx, if the transmitter is idle
+ */
+extern void usys_tx_kick (void);
+#endif
+
+#if USYS_RX_RING_SIZE
+#if (USYS_RX_RING_SIZE & (USYS_RX_RING_SIZE - 1))
+#error "USYS_RX_RING_SIZE must be a power of 2"
+#endif
+extern usys_ring_t usys_rx;                  /*!< stdio RX ring, the port is its producer */
+#endif
+
+/*!
+ * Fixed size object pool data type. Define pools with \ref USYS_POOL_DEF.
+ */
+typedef struct {
+   uint8_t             *mem;      /*!< Storage of \a count objects */
+   uint32_t             size;     /*!< Object size, rounded up to 4 bytes */
+   uint32_t             count;    /*!< Number of objects, up to 65535 */
+   volatile uint32_t    head;     /*!< Free list: tag << 16 | (index + 1) */
+   volatile uint32_t    fresh;    /*!< Number of objects never allocated */
+   volatile uint32_t    used;     /*!< Objects in use */
+   volatile uint32_t    hwm;      /*!< High water mark of \a used */
+}usys_pool_t;
+
+/*!
+ * Define a pool with static storage for \a _n_ objects of \a _size_ bytes.
+ * No initialization call is needed.
+ *
+ * for ex:
+ *    USYS_POOL_DEF (msg_pool, sizeof (msg_t), 16);
+ *    msg_t *m = usys_pool_alloc (&msg_pool);
+ */
+#define  USYS_POOL_DEF(_name_, _size_, _n_)                       \
+   static uint32_t _name_##_mem[(((_size_) + 3) / 4) * (_n_)];    \
+   usys_pool_t _name_ = {                                         \
+      (uint8_t *)_name_##_mem, (((_size_) + 3) / 4) * 4, (_n_), 0, 0, 0, 0 \
+   }
+
+void *usys_pool_alloc (usys_pool_t *p);
+void usys_pool_free (usys_pool_t *p, void *obj);
+
+/*
+ * ===== Heap ========
+ */
+void * _sbrk (int32_t incr);
+
+#if USYS_MEMMON
+/*!
+ * Watermark monitor report, see usys_memmon_report()
+ */
+typedef struct {
+   uintptr_t      base;       /*!< Start of the painted region, the heap break at init */
+   uintptr_t      top;        /*!< End of the painted region, near the stack pointer at init */
+   uintptr_t      heap_max;   /*!< Highest heap break so far */
+   uintptr_t      stack_min;  /*!< Lowest stack word found used, top if none */
+   uint32_t       free_min;   /*!< Smallest gap between them in bytes, 0 if they met */
+   uint32_t       passes;     /*!< Complete scans of the region */
+}usys_memmon_t;
+
+int usys_memmon_init (void);
+void usys_memmon_report (usys_memmon_t *r);
+#endif
+
+#if USYS_HEAP
+void *usys_malloc (size_t size);
+void usys_free (void *ptr);
+void *usys_realloc (void *ptr, size_t size);
+void *usys_calloc (size_t n, size_t size);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
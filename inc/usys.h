@@ -29,8 +29,17 @@
 // system includes
 #include <syscalls.h>
 
+// lock-free ring buffer, used by the stdio backends
+#include <usysring.h>
+
 // time and cron includes (provide time base using SysTick)
 #include <usystime.h>
 
+// cooperative tasks, woken by the software timers
+#include <usystask.h>
+
+// binary trace log
+#include <usystrace.h>
+
 
 #endif // #ifndef __usys_h__
@@ -0,0 +1,126 @@
+/*
+ * \file usysport.h
+ * \brief
+ *    Compiler and core dependent primitives used by usys.
+ * \note
+ *    Every primitive is a macro wrapped in #ifndef, so a port can provide
+ *    its own before including any usys header.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __usysport_h__
+#define __usysport_h__
+
+#include <stdint.h>
+
+/*!
+ * Memory barrier. Orders the memory accesses before it against the ones
+ * after it, both for the compiler and for the core.
+ */
+#ifndef usys_barrier
+#define usys_barrier()        __sync_synchronize ()
+#endif
+
+/*!
+ * Interrupt masking for short critical sections. usys_irq_save() masks the
+ * interrupts and returns the previous state for usys_irq_restore(), so
+ * the sections can nest. The default for the host is a no-op.
+ */
+#ifndef usys_irq_save
+#if defined (__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')
+static inline uint32_t usys_irq_save (void) {
+   uint32_t pm;
+   __asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (pm) :: "memory");
+   return pm;
+}
+static inline void usys_irq_restore (uint32_t pm) {
+   __asm volatile ("msr primask, %0" :: "r" (pm) : "memory");
+}
+#else
+#define usys_irq_save()          (0)
+#define usys_irq_restore(_s_)    ((void)(_s_))
+#endif
+#endif
+
+/*!
+ * 32-bit compare and swap. Stores \a _n_ to \a *_p_ if \a *_p_ equals
+ * \a _o_ and returns non zero on success. It is safe against interrupts.
+ * \note
+ *    ARMv6-M (Cortex-M0/M0+) has no exclusive access instructions, so there
+ *    it masks the interrupts for the few cycles of the swap. That is atomic
+ *    on the calling core only, so with \ref USYS_CPUS the port has to
+ *    provide a usys_cas() over a hardware spinlock (ex: the RP2040's SIO
+ *    spinlocks).
+ */
+#ifndef usys_cas
+#if defined (__ARM_ARCH_6M__)
+#if defined (USYS_CPUS) && (USYS_CPUS > 1)
+#error "USYS_CPUS > 1 on ARMv6-M needs a port usys_cas() over a hardware spinlock"
+#endif
+static inline int usys_cas (volatile uint32_t *p, uint32_t o, uint32_t n) {
+   uint32_t pm = usys_irq_save ();
+   int r;
+   if ((r = (*p == o)))
+      *p = n;
+   usys_irq_restore (pm);
+   return r;
+}
+#else
+#define usys_cas(_p_, _o_, _n_)  __sync_bool_compare_and_swap ((_p_), (_o_), (_n_))
+#endif
+#endif
+
+/*!
+ * Sleep until the next interrupt. It wakes up even with the interrupts
+ * masked by usys_irq_save(). The default for the host is a no-op, so the
+ * waits become busy loops.
+ */
+#ifndef usys_wfi
+#if defined (__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')
+#define usys_wfi()            __asm volatile ("wfi" ::: "memory")
+#else
+#define usys_wfi()            ((void)0)
+#endif
+#endif
+
+/*!
+ * Index of the calling core, from 0 to USYS_CPUS - 1. The default is for
+ * single core parts. for ex:
+ *    RP2040:     #define usys_cpu_id()   (*(volatile uint32_t *)0xD0000000)
+ *    STM32H7:    #define usys_cpu_id()   (((SCB->CPUID >> 4) & 0xFFF) == 0xC24)
+ */
+#ifndef usys_cpu_id
+#define usys_cpu_id()         (0)
+#endif
+
+/*!
+ * Current stack pointer (approximation is enough)
+ */
+#ifndef usys_sp
+#define usys_sp()             ((char *)__builtin_frame_address (0))
+#endif
+
+/*!
+ * Count leading zeros of a non zero 32-bit value
+ */
+#ifndef usys_clz
+#define usys_clz(_x_)         __builtin_clz (_x_)
+#endif
+
+#endif // #ifndef __usysport_h__
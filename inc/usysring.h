@@ -0,0 +1,82 @@
+/*
+ * \file usysring.h
+ * \brief
+ *    Lock-free single producer, single consumer byte ring buffer.
+ * Provides:
+ *    the stdio ring backends of syscalls.c
+ * \note
+ *    The producer only writes head and the consumer only writes tail.
+ *    Both indexes run free and the size is a power of 2, so no locks
+ *    and no divisions are needed.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __usysring_h__
+#define __usysring_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*!
+ * Ring buffer data type
+ */
+typedef struct {
+   uint8_t             *buf;   /*!< Storage */
+   uint32_t             size;  /*!< Storage size. Power of 2 */
+   volatile uint32_t    head;  /*!< Write index, written by the producer only */
+   volatile uint32_t    tail;  /*!< Read index, written by the consumer (and usys_ring_dma_pos() on overrun) */
+   volatile uint32_t    lost;  /*!< Bytes overwritten by usys_ring_dma_pos() before they were read */
+}usys_ring_t;
+
+/*!
+ * Static initializer for a ring over the array \a _buf
+ *
+ * for ex:
+ *    static uint8_t buf[256];
+ *    usys_ring_t r = USYS_RING_INIT (buf);
+ */
+#define  USYS_RING_INIT(_buf_)   { (_buf_), sizeof (_buf_), 0, 0, 0 }
+
+void usys_ring_init (usys_ring_t *r, uint8_t *buf, uint32_t size);
+uint32_t usys_ring_count (const usys_ring_t *r);
+uint32_t usys_ring_free (const usys_ring_t *r);
+
+/*
+ * Producer side
+ */
+uint32_t usys_ring_write (usys_ring_t *r, const uint8_t *src, uint32_t len);
+uint32_t usys_ring_span (usys_ring_t *r, uint8_t **p);
+void usys_ring_produce (usys_ring_t *r, uint32_t n);
+void usys_ring_dma_pos (usys_ring_t *r, uint32_t pos);
+
+/*
+ * Consumer side
+ */
+uint32_t usys_ring_read (usys_ring_t *r, uint8_t *dst, uint32_t len);
+uint32_t usys_ring_peek (usys_ring_t *r, const uint8_t **p);
+void usys_ring_consume (usys_ring_t *r, uint32_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // #ifndef __usysring_h__
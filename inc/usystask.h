@@ -0,0 +1,178 @@
+/*
+ * \file usystask.h
+ * \brief
+ *    Cooperative stackless tasks (protothreads) on top of the usys time
+ *    base.
+ * Provides:
+ *    usys_task_start(), usys_task_run() and the USYS_TASK_xxx macros
+ * \note
+ *    A task is a function that returns every time it waits and resumes at
+ *    the same point on its next run, with C switch/case continuations. It
+ *    has no stack of its own, so local variables do not survive a wait.
+ *    Keep the state in the task's \a arg (or in static variables).
+ *    The continuations use __LINE__, so write at most one USYS_TASK_xxx
+ *    wait per line, and no switch statement around a wait.
+ *    The tasks run from the main loop via usys_task_run(), never from the
+ *    SysTick ISR. With \ref USYS_TIMERS a task that waits for a delay is
+ *    woken by its own software timer and costs nothing until then.
+ *    With \ref USYS_CPUS the tasks belong to a single core. Start, stop and
+ *    run them from that core.
+ *
+ *    for ex:
+ *       static int blink (usys_task_t *t) {
+ *          USYS_TASK_BEGIN (t);
+ *          for (;;) {
+ *             led_toggle ();
+ *             USYS_TASK_DELAY (t, usys_msec (500));
+ *          }
+ *          USYS_TASK_END (t);
+ *       }
+ *
+ *       usys_task_start (&blink_task, blink, NULL);
+ *       for (;;)
+ *          usys_task_run ();
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __usystask_h__
+#define __usystask_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <usystime.h>
+
+/*
+ * ===== Data types ========
+ */
+
+/*
+ * Task function return codes
+ */
+#define  USYS_TASK_WAITING    (0)   /*!< Blocked, until usys_task_wake() or its timer */
+#define  USYS_TASK_READY      (1)   /*!< Run again on the next usys_task_run() */
+#define  USYS_TASK_DONE       (2)   /*!< Finished, leaves the scheduler */
+
+typedef struct usys_task usys_task_t;
+typedef int (*taskfun_t) (usys_task_t *);    /*!< Pointer to task function */
+
+/*!
+ * Task data type. The object belongs to the User, the scheduler links it
+ * while the task is started.
+ */
+struct usys_task {
+   taskfun_t               fun;     /*!< Task function */
+   void                   *arg;     /*!< Task argument, see usys_task_arg() */
+   usys_task_t            *next;    /*!< Link in the task list */
+   unsigned int            lc;      /*!< Local continuation, 0 on start */
+   volatile uint8_t        ready;   /*!< Set to run on the next usys_task_run() */
+   mclock_t                dl;      /*!< Deadline of the current delay */
+#if USYS_TIMERS
+   usys_timer_t            tmr;     /*!< Wake up timer of the delays */
+#endif
+};
+
+/*
+ * ===== Task macros ========
+ */
+
+// The continuations fall through to their case label on purpose
+#if defined (__GNUC__) && (__GNUC__ >= 7)
+#define  _USYS_TASK_FALL      __attribute__ ((fallthrough))
+#else
+#define  _USYS_TASK_FALL
+#endif
+
+/*! Task argument */
+#define  usys_task_arg(_t_)   ((_t_)->arg)
+
+/*! Start of the task body */
+#define  USYS_TASK_BEGIN(_t_)    switch ((_t_)->lc) { case 0:
+
+/*! End of the task body. The task is done */
+#define  USYS_TASK_END(_t_)      } (_t_)->lc = 0; return USYS_TASK_DONE
+
+/*! Leave the task and let the others run. It resumes on the next run */
+#define  USYS_TASK_YIELD(_t_)                      \
+   do {                                            \
+      (_t_)->lc = __LINE__;                        \
+      return USYS_TASK_READY;                      \
+      case __LINE__:;                              \
+   } while (0)
+
+/*!
+ * Wait until \a _c_ is true. The condition is polled on every run, so for
+ * conditions set from an ISR prefer USYS_TASK_WAIT_EVENT().
+ */
+#define  USYS_TASK_WAIT_UNTIL(_t_, _c_)            \
+   do {                                            \
+      (_t_)->lc = __LINE__;                        \
+      _USYS_TASK_FALL;                             \
+      case __LINE__:                               \
+      if (!(_c_))                                  \
+         return USYS_TASK_READY;                   \
+   } while (0)
+
+/*!
+ * Wait until \a _c_ is true. The task sleeps until someone calls
+ * usys_task_wake() on it, then checks the condition again.
+ */
+#define  USYS_TASK_WAIT_EVENT(_t_, _c_)            \
+   do {                                            \
+      (_t_)->lc = __LINE__;                        \
+      _USYS_TASK_FALL;                             \
+      case __LINE__:                               \
+      if (!(_c_))                                  \
+         return USYS_TASK_WAITING;                 \
+   } while (0)
+
+/*! Wait until the mclock() deadline \a _dl_, see usys_deadline() */
+#define  USYS_TASK_WAIT_DEADLINE(_t_, _dl_)        \
+   do {                                            \
+      usys_task_sleep ((_t_), (_dl_));             \
+      (_t_)->lc = __LINE__;                        \
+      _USYS_TASK_FALL;                             \
+      case __LINE__:                               \
+      if (!usys_expired ((_t_)->dl))               \
+         return usys_task_blocked (_t_);            \
+   } while (0)
+
+/*! Wait for \a _dt_ ticks */
+#define  USYS_TASK_DELAY(_t_, _dt_)    USYS_TASK_WAIT_DEADLINE (_t_, usys_deadline (_dt_))
+
+/*! Leave and finish the task */
+#define  USYS_TASK_EXIT(_t_)     do { (_t_)->lc = 0; return USYS_TASK_DONE; } while (0)
+
+/*
+ * ===== Scheduler ========
+ */
+void usys_task_start (usys_task_t *t, taskfun_t fun, void *arg);
+void usys_task_stop (usys_task_t *t);
+void usys_task_wake (usys_task_t *t);
+void usys_task_sleep (usys_task_t *t, mclock_t dl);
+int usys_task_run (void);
+
+int usys_task_blocked (usys_task_t *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // #ifndef __usystask_h__
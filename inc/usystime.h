@@ -7,6 +7,7 @@
  * \note
  *    This module provides SysTick_Callback(). In order to work the
  *    User has to implement a SysTick_IRQ and call this function
+ *    or define it with USYS_SYSTICK_HANDLER(), that inlines the tick.
  *
  * This file is part of usys
  *
@@ -34,12 +35,237 @@ extern "C" {
 #endif
 
 #include <sys/types.h>
+#include <sys/time.h>
+#include <stdint.h>
 #include <limits.h>
 
 /*
  * ======= User defines =============
  */
+#ifndef USYS_CRONTAB_ENTRIES
 #define USYS_CRONTAB_ENTRIES      (10)
+#endif
+
+/*!
+ * Number of cores that run a usys scheduler. Each core gets its own crontab,
+ * timer wheel, deferred queue and software timers, and calls
+ * SysTick_Callback() from its own tick interrupt. The time base belongs to
+ * core 0, and the other cores read it lock-free. The port provides
+ * usys_cpu_id(), see usysport.h.
+ * \note
+ *    The primitives the cores can share (event flags, the trace ring, the
+ *    pools) rely on a usys_cas() that is atomic across the cores.
+ */
+#ifndef USYS_CPUS
+#define USYS_CPUS                 (1)
+#endif
+
+/*!
+ * Compile time frequency of the time base in Hz. When not 0, the
+ * \ref USYS_MSEC() and \ref USYS_SEC() macros convert to ticks at compile
+ * time, for ex: for the periods of USYS_SERVICE().
+ */
+#ifndef USYS_FREQ
+#define USYS_FREQ                 (0)
+#endif
+
+/*!
+ * Number of buckets in the cron timer wheel. Each tick the scheduler visits
+ * only the bucket that is due, so the per tick cost is roughly
+ * USYS_CRONTAB_ENTRIES / USYS_CRON_WHEEL_SLOTS entries. The default is the
+ * power of 2 at or above USYS_CRONTAB_ENTRIES, at least 32 and at most 1024,
+ * so a bucket holds about one entry and the tick does not grow with the
+ * table. Each slot is a pointer of RAM on each core.
+ * \note
+ *    Must be a power of 2
+ */
+#ifndef USYS_CRON_WHEEL_SLOTS
+#define USYS_CRON_WHEEL_SLOTS     (                  \
+   (USYS_CRONTAB_ENTRIES <=  32) ?   32 :              \
+   (USYS_CRONTAB_ENTRIES <=  64) ?   64 :              \
+   (USYS_CRONTAB_ENTRIES <= 128) ?  128 :              \
+   (USYS_CRONTAB_ENTRIES <= 256) ?  256 :              \
+   (USYS_CRONTAB_ENTRIES <= 512) ?  512 : 1024)
+#endif
+
+/*!
+ * RTC resync period in seconds. With an external time provider (see
+ * usys_set_rtc_time()) time() returns a cached copy of the RTC, that the
+ * time base keeps counting, and reads the RTC again only every
+ * USYS_RTC_RESYNC seconds. 0 calls the provider on every time().
+ */
+#ifndef USYS_RTC_RESYNC
+#define USYS_RTC_RESYNC           (60)
+#endif
+
+/*!
+ * Calendar clock trim. Each second of __now lasts get_freq() ticks plus a
+ * trim in ppm, see usys_set_trim(). The fraction of a tick is accumulated
+ * from second to second in fixed point, so SysTick_Callback() does only an
+ * add and a shift. For crystals that drift, when there is no RTC to poll.
+ */
+#ifndef USYS_TIME_TRIM
+#define USYS_TIME_TRIM            (0)
+#endif
+
+/*!
+ * Trim learning. When not 0, each settime() without an external RTC
+ * corrects the trim by the error it fixes, if at least USYS_TIME_TRIM_LEARN
+ * seconds passed since the previous settime(). The minimum bounds the
+ * error of the estimate, since the set time is rounded to seconds.
+ * Needs \ref USYS_TIME_TRIM.
+ */
+#ifndef USYS_TIME_TRIM_LEARN
+#define USYS_TIME_TRIM_LEARN      (0)
+#endif
+
+/*!
+ * Tickless mode. Instead of a fixed rate SysTick_IRQ calling SysTick_Callback(),
+ * the HAL programs its timer via \ref set_compare() to interrupt only on the
+ * next cron deadline and reports the elapsed ticks with SysTick_Advance().
+ */
+#ifndef USYS_TICKLESS
+#define USYS_TICKLESS             (0)
+#endif
+
+/*!
+ * Maximum number of ticks for one tickless sleep, used when no cron entry is
+ * due sooner. The HAL may clamp it further to its timer range.
+ */
+#ifndef USYS_TICKLESS_MAX
+#define USYS_TICKLESS_MAX         (0xFFFF)
+#endif
+
+/*!
+ * High resolution clock. Provides usys_cycles() and usys_clock_ns() by
+ * combining the tick count with the time base's hardware down-counter.
+ * The HAL has to provide \ref get_count(), \ref get_reload() and
+ * \ref get_pending(). With \ref USYS_CPUS they read the counter of the
+ * primary core's time base.
+ */
+#ifndef USYS_HIRES_CLOCK
+#define USYS_HIRES_CLOCK          (0)
+#endif
+
+/*!
+ * 64-bit monotonic CPU time. When enabled mclock_t is 64 bits wide and
+ * never rolls over. On 32-bit targets mclock() reads the two halves without
+ * disabling interrupts, re-reading the high half until it is stable.
+ */
+#ifndef USYS_CLOCK64
+#define USYS_CLOCK64              (0)
+#endif
+
+/*!
+ * Maximum number of armed software timers, see usys_timer_start().
+ * 0 removes the software timers.
+ */
+#ifndef USYS_TIMERS
+#define USYS_TIMERS               (8)
+#endif
+
+/*!
+ * Runtime statistics of SysTick_Callback() and of each cron service,
+ * see usys_service_stats() and usys_isr_stats().
+ */
+#ifndef USYS_PROFILE
+#define USYS_PROFILE              (0)
+#endif
+
+/*!
+ * Free running 32-bit cycle counter used by \ref USYS_PROFILE. The default
+ * is the high resolution clock if enabled, or DWT->CYCCNT otherwise (the
+ * application has to enable the DWT cycle counter).
+ */
+#ifndef USYS_PROFILE_CYCLES
+#if USYS_HIRES_CLOCK
+#define USYS_PROFILE_CYCLES()     ((uint32_t)usys_cycles ())
+#else
+#define USYS_PROFILE_CYCLES()     (*(volatile uint32_t *)0xE0001004)
+#endif
+#endif
+
+/*!
+ * Tick period in \ref USYS_PROFILE_CYCLES() cycles, used to count the
+ * missed ticks. 0 disables the count.
+ */
+#ifndef USYS_PROFILE_TICK_CYCLES
+#if USYS_HIRES_CLOCK
+#define USYS_PROFILE_TICK_CYCLES()   (get_reload () + 1)
+#else
+#define USYS_PROFILE_TICK_CYCLES()   (0)
+#endif
+#endif
+
+/*!
+ * Start time jitter of each cron service, see usys_service_jitter(), and
+ * time base drift against the RTC, see usys_drift(). Needs \ref USYS_PROFILE
+ * and a non zero \ref USYS_PROFILE_TICK_CYCLES().
+ */
+#ifndef USYS_PROFILE_JITTER
+#define USYS_PROFILE_JITTER       (0)
+#endif
+
+/*!
+ * Number of bins of the jitter histograms. Bin 0 counts the exact starts,
+ * bin k the errors of 2^(k-1) up to 2^k - 1 cycles, the last bin the rest.
+ */
+#ifndef USYS_JITTER_BINS
+#define USYS_JITTER_BINS          (16)
+#endif
+
+/*!
+ * Service budgets and admission control, see service_budget(). Needs
+ * \ref USYS_PROFILE and a non zero \ref USYS_PROFILE_TICK_CYCLES().
+ */
+#ifndef USYS_CRON_BUDGET
+#define USYS_CRON_BUDGET          (0)
+#endif
+
+/*!
+ * Percent of a tick that the budgets of the services run by the SysTick
+ * ISR may add up to. Any of them may come due on the same tick, so the
+ * bound holds regardless of their phases.
+ */
+#ifndef USYS_CRON_ISR_LOAD
+#define USYS_CRON_ISR_LOAD        (50)
+#endif
+
+/*!
+ * Percent of the CPU that all the services with a budget may use, as the
+ * sum of budget / period. The default is the rate monotonic bound for
+ * many tasks (ln 2), 100 is the EDF bound.
+ */
+#ifndef USYS_CRON_UTIL_MAX
+#define USYS_CRON_UTIL_MAX        (69)
+#endif
+
+/*!
+ * Data cache line size in bytes. The time base state is aligned to it, so
+ * the tick interrupt touches a single line. The build fails when the state
+ * does not fit, for ex: with a 64-bit clock_t and a 32 byte line.
+ */
+#ifndef USYS_CACHE_LINE
+#define USYS_CACHE_LINE           (32)
+#endif
+
+/*!
+ * Name of the handler that USYS_SYSTICK_HANDLER() defines
+ */
+#ifndef USYS_SYSTICK_VECTOR
+#define USYS_SYSTICK_VECTOR       SysTick_Handler
+#endif
+
+/*!
+ * Size of the deferred services ready queue, see \ref USYS_SRV_DEFERRED.
+ * Each service is queued at most once, so a size not less than the number
+ * of deferred services never overflows.
+ * \note
+ *    Must be a power of 2
+ */
+#ifndef USYS_CRON_QUEUE_SIZE
+#define USYS_CRON_QUEUE_SIZE      (16)
+#endif
 
 /*
  * ===== Data types ========
@@ -79,6 +305,28 @@ typedef _TIME_T_ time_t;               /*!< date/time in unix secs past 1-Jan-70
  */
 typedef long   sclock_t;
 
+/*!
+ * Monotonic CPU time, read by \ref mclock(). Unlike clock() and sclock()
+ * it can not be set, so it is the time base for timeouts. Use the
+ * \ref usys_deadline() and \ref usys_expired() helpers instead of
+ * _CLOCK_DIFF/_SCLOCK_DIFF:
+ *
+ *    // wait 10 ticks
+ *    mclock_t dl = usys_deadline (10);
+ *    while (!usys_expired (dl))
+ *       ;
+ *
+ * With \ref USYS_CLOCK64 it is 64 bits and does not roll over. Otherwise
+ * the helpers are roll over safe for timeouts up to _SCLOCK_T_MAX_VALUE_.
+ */
+#if USYS_CLOCK64
+typedef uint64_t  mclock_t;
+typedef int64_t   smclock_t;           /*!< Signed difference of mclock_t values */
+#else
+typedef clock_t   mclock_t;
+typedef sclock_t  smclock_t;           /*!< Signed difference of mclock_t values */
+#endif
+
 /*
  * =========== Helper macros ===============
  */
@@ -123,41 +371,310 @@ typedef long   sclock_t;
  */
 #define _SCLOCK_DIFF(_t2_, _t1_)         ( ((_t2_)>(_t1_)) ? ((_t2_)-(_t1_)) : ((_SCLOCK_T_MAX_VALUE_ - _SCLOCK_T_MIN_VALUE_) - ((_t1_) - (_t2_)) + 1) )
 
+/*!
+ * Monotonic deadline helpers. Each argument is evaluated once and the test
+ * is a single subtraction.
+ */
+#define  usys_deadline(_dt_)     (mclock () + (mclock_t)(_dt_))
+#define  usys_expired(_dl_)      ((smclock_t)(mclock () - (mclock_t)(_dl_)) >= 0)
+
 /*
  * CPU time macros
  */
-#define  usys_msec(_ms_)      (((_ms_) * get_freq()) / 1000)
-#define  usys_sec(_s_)        ((_s_) * get_freq())
+#define  usys_msec(_ms_)      (((_ms_) * usys_get_freq()) / 1000)
+#define  usys_sec(_s_)        ((_s_) * usys_get_freq())
+
+#if USYS_FREQ
+#define  USYS_MSEC(_ms_)      ((clock_t)(((_ms_) * (uint64_t)USYS_FREQ) / 1000))
+#define  USYS_SEC(_s_)        ((clock_t)((_s_) * USYS_FREQ))
+#endif
+
+/*
+ * Service flags for service_add_ex()
+ */
+#define  USYS_SRV_DEFERRED    (0x01)   /*!< Run from usys_run_pending() instead of the SysTick ISR */
+#define  USYS_SRV_STAGGER     (0x02)   /*!< Pick the phase automatically, on the least loaded tick */
+#define  USYS_SRV_CATCHUP     (0x04)   /*!< After a late SysTick_Advance(), run once per missed period */
+#define  USYS_SRV_DEMOTED     (0x08)   /*!< Set by the scheduler, when a service overruns its budget */
 
 typedef void (*cronfun_t) (void);            /*!< Pointer to void function (void) to use with cron */
 typedef time_t (*ext_time_ft) (time_t *);    /*!< Pointer type for External time function. */
 typedef int (*ext_settime_ft) (const time_t *); /*!< Pointer type for External set time function. */
 
 /*!
- * Cron Table data type
+ * Runtime statistics in \ref USYS_PROFILE_CYCLES() cycles
+ */
+typedef struct {
+   uint32_t    calls;   /*!< Number of calls */
+   uint32_t    min;     /*!< Minimum cycles of a call */
+   uint32_t    max;     /*!< Maximum cycles of a call */
+   uint64_t    sum;     /*!< Cumulative cycles */
+#if USYS_CRON_BUDGET
+   uint32_t    over;    /*!< Calls over the budget, see service_budget() */
+#endif
+}usys_stat_t;
+
+/*!
+ * Start time error of a service, in \ref USYS_PROFILE_CYCLES() cycles.
+ * The error of a start is the time since the previous start minus the
+ * service period. Negative is early, positive is late.
+ */
+typedef struct {
+   uint32_t    calls;   /*!< Number of measured periods */
+   int32_t     min;     /*!< Most early start */
+   int32_t     max;     /*!< Most late start */
+   uint64_t    sum;     /*!< Cumulative absolute error */
+   uint32_t    hist[USYS_JITTER_BINS];  /*!< Histogram of the absolute error in log2 bins */
+}usys_jitter_t;
+
+/*!
+ * Drift of the time base against the RTC, see usys_drift()
+ */
+typedef struct {
+   uint32_t    secs;    /*!< RTC seconds measured */
+   mclock_t    ticks;   /*!< Ticks counted in the same time */
+   int32_t     ppm;     /*!< Drift in ppm. Positive: the time base runs fast */
+}usys_drift_t;
+
+/*!
+ * SysTick_Callback() statistics
+ */
+typedef struct {
+   usys_stat_t isr;     /*!< Total ISR time */
+   uint32_t    missed;  /*!< Ticks lost because an ISR entry came late */
+}usys_isr_stat_t;
+
+/*!
+ * Cron entry states. The state is the entry's publish point:
+ *  - service_add() claims a FREE slot with a compare and swap, fills it
+ *    and then stores ADD behind a barrier. The ISR ignores CLAIM slots.
+ *  - service_rem() swaps ADD/ACTIVE to REM. The ISR calls only ACTIVE
+ *    entries.
+ *  - The ISR swaps ADD to ACTIVE and links the entry, or stores FREE for a
+ *    REM entry after unlinking it.
+ * So entries can be changed from any context without masking interrupts.
+ */
+typedef enum {
+   CRON_FREE =0,     //!< Free slot
+   CRON_ADD,         //!< Filled by service_add(), waiting to be linked. exp is relative
+   CRON_ACTIVE,      //!< Linked in the wheel
+   CRON_REM,         //!< Marked by service_rem(), waiting to be unlinked
+   CRON_CLAIM        //!< Reserved by service_add(), being filled
+}cron_state_en;
+
+/*!
+ * Service descriptor, the constant part of a cron entry. USYS_SERVICE()
+ * places it in flash, service_add() fills the one of its crontab[] slot.
  */
 typedef struct {
-   cronfun_t   fun;
-   clock_t     tic;
+   cronfun_t               fun;     /*!< Service function */
+   clock_t                 tic;     /*!< Service period in ticks */
+}usys_service_t;
+
+/*!
+ * Cron Table data type, the runtime state of a service
+ * \note
+ *    Deadlines are kept in the scheduler's own time, which never rewinds.
+ *    Each run re-arms \a exp by exactly the period, so the entries do not
+ *    drift and setclock()/setsclock() do not affect them.
+ */
+typedef struct crontab {
+   const usys_service_t   *srv;     /*!< Service function and period */
+   clock_t                 exp;     /*!< Next absolute deadline in scheduler ticks */
+   struct crontab         *next;    /*!< Next entry in the same wheel bucket */
+   volatile uint32_t       state;   /*!< Entry state, cron_state_en */
+   uint8_t                 flags;   /*!< Service flags USYS_SRV_xxx */
+   volatile uint8_t        pend;    /*!< Waiting in the deferred queue */
+#if USYS_PROFILE
+   usys_stat_t             stat;    /*!< Runtime statistics */
+#if USYS_CRON_BUDGET
+   uint32_t                wcet;    /*!< Budget in cycles, 0 for none */
+#endif
+#if USYS_PROFILE_JITTER
+   uint32_t                start;   /*!< Cycles at the previous start */
+   usys_jitter_t           jit;     /*!< Start time error statistics */
+#endif
+#endif
 }crontab_t;
 
 
+/*!
+ * Register a static service at compile time. The function and the period
+ * go in a const descriptor in flash. Only the runtime state of the entry
+ * is in RAM, and a pointer to it goes in the usys_services linker section.
+ * So it takes no _crontab[] slot and no service_add() call. The scheduler
+ * links all of them on the first tick. With static services only,
+ * USYS_CRONTAB_ENTRIES can be 0.
+ *
+ * for ex:
+ *    static void led (void) { ... }
+ *    USYS_SERVICE (led, USYS_MSEC (500));
+ *
+ * \param   _fn_     The service function. Must be an identifier
+ * \param   _tic_    Tick period, a constant expression
+ * \note
+ *    The section is an orphan for the linker, GNU ld places it by itself.
+ *    With --gc-sections, keep it in the linker script (KEEP(*(usys_services))).
+ */
+#define  USYS_SERVICE(_fn_, _tic_)     USYS_SERVICE_EX (_fn_, _tic_, 0, 0)
+
+/*!
+ * Register a static service with a phase and service flags.
+ * \sa USYS_SERVICE(), service_add_ex()
+ */
+#define  USYS_SERVICE_EX(_fn_, _tic_, _phase_, _flags_)                    \
+   typedef char _usys_srv_chk_##_fn_[(_tic_) ? 1 : -1];                    \
+   static const usys_service_t _usys_srvd_##_fn_ = { (_fn_), (_tic_) };    \
+   static crontab_t _usys_srv_##_fn_ = {                                   \
+      .srv = &_usys_srvd_##_fn_, .exp = (_tic_) + (_phase_),               \
+      .state = CRON_ADD, .flags = (_flags_)                                \
+   };                                                                      \
+   static crontab_t * const _usys_srvp_##_fn_                              \
+      __attribute__ ((used, section ("usys_services"))) = &_usys_srv_##_fn_
+
+typedef void (*timerfun_t) (void *);        /*!< Pointer to software timer callback */
+
+/*!
+ * Software timer data type. The timer object belongs to the User, usys
+ * keeps a pointer to it while it is armed.
+ */
+typedef struct {
+   timerfun_t              fun;     /*!< Callback */
+   void                   *arg;     /*!< Callback argument */
+   mclock_t                exp;     /*!< Absolute deadline in mclock() ticks */
+   clock_t                 period;  /*!< Reload period, 0 for one-shot */
+   uint8_t                 prio;    /*!< Priority on the same tick, higher runs first */
+   volatile uint16_t       idx;     /*!< Position in the deadline heap + 1, 0 when stopped */
+}usys_timer_t;
+
+/*!
+ * Event flags data type. Up to 32 event bits that an ISR, a cron service or
+ * a timer sets and the main loop waits for, see usys_event_wait().
+ */
+typedef struct {
+   volatile uint32_t       bits;    /*!< The set event bits */
+}usys_event_t;
+
+#if USYS_CLOCK64 && (ULONG_MAX <= 0xFFFFFFFFUL)
+#define  _USYS_MTICKS_HI      (1)
+#endif
+
+/*!
+ * Time base state, packed in one cache line. The tick interrupt counts only
+ * \a mticks, clock() and sclock() are offsets over it.
+ * \note
+ *    Private to usys. It is public only for usys_systick().
+ */
+typedef struct {
+   volatile time_t   now;           /*!< Time in UNIX seconds past 1-Jan-70, first as it can be 64-bit */
+   volatile clock_t  mticks;        /*!< Monotonic tick count */
+   volatile clock_t  sec_cnt;       /*!< Ticks left until the next second of \a now */
+   volatile clock_t  due;           /*!< \a mticks of the next scheduler event */
+   volatile clock_t  ticks_ofs;     /*!< clock() - \a mticks */
+   volatile clock_t  sticks_ofs;    /*!< sclock() - \a mticks */
+#ifdef _USYS_MTICKS_HI
+   volatile clock_t  mticks_hi;     /*!< High half of the 64-bit monotonic count */
+#endif
+}usys_tbase_t;
+
+/*
+ * Compile time check that the state fits in one cache line
+ */
+typedef char _usys_tbase_chk[(sizeof (usys_tbase_t) <= USYS_CACHE_LINE) ? 1 : -1];
+
+extern usys_tbase_t __usys_tbase;
+
+#define  USYS_EVENT_INIT      { 0 }          /*!< Static initializer, no bits set */
+#define  USYS_EVENT_FOREVER   ((clock_t)-1)  /*!< usys_event_wait() with no timeout */
+
+/*
+ * usys_event_wait() modes
+ */
+#define  USYS_EVENT_ANY       (0x00)   /*!< Wait for any of the bits */
+#define  USYS_EVENT_ALL       (0x01)   /*!< Wait for all of the bits */
+#define  USYS_EVENT_CLEAR     (0x02)   /*!< Clear the bits that satisfied the wait */
+
 /*
  * ========= Set Functions ============
  */
 void usys_set_rtc_time (ext_time_ft f);
 void usys_set_rtc_settime (ext_settime_ft f);
+void usys_freq_changed (void);
+int usys_set_freq (clock_t sf);
+clock_t usys_get_freq (void);
+#if USYS_TIME_TRIM
+void usys_set_trim (int32_t ppm);
+int32_t usys_get_trim (void);
+#endif
 
 /*
  * ======== OS like Functionalities ============
  */
 void SysTick_Callback (void);
+void SysTick_Advance (clock_t n);
+clock_t usys_next_deadline (void);
+
+/*
+ * Tick fast path. With one core and no profiling the tick only counts, and
+ * calls the scheduler when a second ends or the next event is due.
+ */
+#define  _USYS_TICK_FAST      (USYS_CPUS == 1 && !USYS_PROFILE)
+
+#if _USYS_TICK_FAST
+void usys_systick_event (void);
+
+/*!
+ * \brief
+ *    The body of SysTick_Callback(), inlined. Use it from the tick
+ *    interrupt handler, or USYS_SYSTICK_HANDLER() to define the handler.
+ */
+static inline void usys_systick (void)
+{
+   usys_tbase_t *t = &__usys_tbase;
+   clock_t m = t->mticks + 1;
+
+   t->mticks = m;
+#ifdef _USYS_MTICKS_HI
+   if (!m)
+      ++t->mticks_hi;
+#endif
+   if (!--t->sec_cnt || (sclock_t)(m - t->due) >= 0)
+      usys_systick_event ();
+}
+#else
+#define  usys_systick()       SysTick_Callback ()
+#endif
+
+/*!
+ * Define the tick interrupt handler \ref USYS_SYSTICK_VECTOR with the tick
+ * inlined, to use directly in the vector table instead of a handler that
+ * calls SysTick_Callback().
+ *
+ * for ex:
+ *    USYS_SYSTICK_HANDLER ();
+ */
+#define  USYS_SYSTICK_HANDLER()                                            \
+   void USYS_SYSTICK_VECTOR (void) { usys_systick (); }                    \
+   typedef char _usys_systick_handler_chk
 
 /*
  * extern declarations (from a HAL or Driver)
  */
 extern clock_t get_freq (void);
 extern int set_freq (clock_t sf);
+#if USYS_TICKLESS
+/*!
+ * Program the time base to call SysTick_Advance() after at most \a dt ticks
+ * from now. On that call the HAL passes all the ticks elapsed since the
+ * previous SysTick_Advance().
+ */
+extern void set_compare (clock_t dt);
+#endif
+#if USYS_HIRES_CLOCK
+extern uint32_t get_count (void);   /*!< Current value of the tick down-counter (ex: SysTick->VAL) */
+extern uint32_t get_reload (void);  /*!< Reload value of the tick down-counter (ex: SysTick->LOAD) */
+extern int get_pending (void);      /*!< Non zero when the down-counter reloaded and its tick interrupt did not run yet (ex: SCB->ICSR PENDSTSET) */
+#endif
 
 clock_t clock (void);
 clock_t setclock (clock_t c);
@@ -165,11 +682,50 @@ clock_t setclock (clock_t c);
 sclock_t sclock (void);
 sclock_t setsclock (sclock_t c);
 
+mclock_t mclock (void);
+
 time_t time (time_t *timer);
 int settime (const time_t *t);
+int usys_gettimeofday (struct timeval *tv, void *tz);
+
+#if USYS_HIRES_CLOCK
+uint64_t usys_cycles (void);
+uint64_t usys_clock_ns (void);
+#endif
 
-void service_add (cronfun_t pfun, clock_t interval);
+int service_add (cronfun_t pfun, clock_t interval);
+int service_add_ex (cronfun_t pfun, clock_t interval, clock_t phase, uint8_t flags);
 void service_rem (cronfun_t pfun);
+#if USYS_CRON_BUDGET
+int service_budget (cronfun_t pfun, uint32_t wcet);
+#endif
+int usys_run_pending (void);
+
+#if USYS_TIMERS
+void usys_timer_init (usys_timer_t *t, timerfun_t fun, void *arg, uint8_t prio);
+int usys_timer_start (usys_timer_t *t, clock_t delay, clock_t period);
+void usys_timer_stop (usys_timer_t *t);
+int usys_timer_active (const usys_timer_t *t);
+#endif
+
+void usys_wait_until (mclock_t dl);
+void usys_delay_us (uint32_t us);
+void usys_delay_ms (uint32_t ms);
+
+void usys_event_set (usys_event_t *ev, uint32_t bits);
+void usys_event_clear (usys_event_t *ev, uint32_t bits);
+uint32_t usys_event_wait (usys_event_t *ev, uint32_t bits, uint8_t mode, clock_t timeout);
+
+#if USYS_PROFILE
+int usys_service_stats (cronfun_t pfun, usys_stat_t *st);
+void usys_isr_stats (usys_isr_stat_t *st);
+void usys_stats_reset (void);
+#if USYS_PROFILE_JITTER
+int usys_service_jitter (cronfun_t pfun, usys_jitter_t *st);
+int usys_drift (usys_drift_t *d);
+void usys_drift_reset (void);
+#endif
+#endif
 
 
 #ifdef __cplusplus
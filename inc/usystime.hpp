@@ -0,0 +1,180 @@
+/*
+ * \file usystime.hpp
+ * \brief
+ *    C++ header only front-end of usystime
+ * Provides:
+ *    usys::basic_clock, usys::deadline, usys::ticks(), usys::service_add()
+ * \note
+ *    With the frequency as a template parameter all tick conversions are
+ *    constexpr, so timeout math folds to constants. Each argument is
+ *    evaluated once, unlike the _CLOCK_DIFF/usys_msec macros.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __usystime_hpp__
+#define __usystime_hpp__
+
+#include <chrono>
+#include <ratio>
+#include <type_traits>
+#include <usystime.h>
+
+namespace usys {
+
+/*!
+ * std::chrono compatible clock over the usys time base. It reads the
+ * monotonic mclock(), so setclock() does not affect it and it is steady.
+ * The rep is mclock_t made unsigned, so the time point arithmetic wraps with
+ * the counter instead of overflowing. Compare time points by their
+ * difference, as deadline does, and not with operator<.
+ *
+ * for ex:
+ *    using clk = usys::basic_clock<1000>;
+ *    auto t0 = clk::now ();
+ *    ...
+ *    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(clk::now () - t0);
+ *
+ * \tparam Freq   The time base frequency in Hz
+ */
+template <clock_t Freq>
+struct basic_clock {
+   static_assert (Freq > 0, "usys::basic_clock: Freq must be positive");
+
+   using rep         = typename std::make_unsigned<mclock_t>::type;
+   using period      = std::ratio<1, Freq>;
+   using duration    = std::chrono::duration<rep, period>;
+   using sduration   = std::chrono::duration<smclock_t, period>;   //!< Signed difference of time points
+   using time_point  = std::chrono::time_point<basic_clock>;
+   static constexpr bool is_steady = true;
+   static constexpr clock_t frequency = Freq;
+
+   //! Current time point
+   static time_point now () noexcept {
+      return time_point (duration (static_cast<rep>(mclock ())));
+   }
+};
+
+/*!
+ * Converts a duration to ticks of \a Clock. With a constant duration this
+ * is a compile time constant.
+ *
+ * for ex:
+ *    constexpr clock_t t = usys::ticks<clk>(std::chrono::milliseconds (10));
+ */
+template <class Clock, class Rep, class Period>
+constexpr clock_t ticks (std::chrono::duration<Rep, Period> d) {
+   return static_cast<clock_t>(
+      std::chrono::duration_cast<typename Clock::duration>(d).count ()
+   );
+}
+
+/*!
+ * Positive difference \a t2 - \a t1 of clock() values, \a t2 after \a t1.
+ * The same as _CLOCK_DIFF, but each argument is evaluated once.
+ */
+constexpr clock_t clock_diff (clock_t t2, clock_t t1) noexcept {
+   return static_cast<clock_t>(t2 - t1);
+}
+
+/*!
+ * Positive difference \a t2 - \a t1 of sclock() values, \a t2 after \a t1.
+ * The same as _SCLOCK_DIFF, but each argument is evaluated once.
+ */
+constexpr sclock_t sclock_diff (sclock_t t2, sclock_t t1) noexcept {
+   return static_cast<sclock_t>(
+      static_cast<unsigned long>(t2) - static_cast<unsigned long>(t1)
+   );
+}
+
+/*!
+ * Type safe timeout on a usys clock. It is roll over safe for timeouts
+ * up to half of the mclock_t range.
+ *
+ * for ex:
+ *    usys::deadline<clk> dl {std::chrono::milliseconds (50)};
+ *    while (!ready ())
+ *       if (dl.expired ()) return timeout;
+ *
+ * \tparam Clock  A usys::basic_clock
+ */
+template <class Clock>
+class deadline {
+   public:
+      using clock       = Clock;
+      using duration    = typename Clock::duration;
+      using sduration   = typename Clock::sduration;
+      using time_point  = typename Clock::time_point;
+
+      //! Deadline \a d after now
+      template <class Rep, class Period>
+      explicit deadline (std::chrono::duration<Rep, Period> d) noexcept
+         : at_ {Clock::now () + std::chrono::duration_cast<duration>(d)} { }
+
+      //! Deadline at the time point \a tp
+      explicit deadline (time_point tp) noexcept
+         : at_ {tp} { }
+
+      //! The deadline time point
+      time_point at () const noexcept { return at_; }
+
+      //! True when the deadline has passed
+      bool expired () const noexcept {
+         return remaining ().count () <= 0;
+      }
+
+      //! Time left to the deadline, negative when it has passed
+      sduration remaining () const noexcept {
+         return sduration (static_cast<smclock_t>(
+            at_.time_since_epoch ().count () - static_cast<typename Clock::rep>(mclock ())
+         ));
+      }
+
+      //! Move the deadline \a d forward, for periodic loops without drift
+      template <class Rep, class Period>
+      deadline& advance (std::chrono::duration<Rep, Period> d) noexcept {
+         at_ += std::chrono::duration_cast<duration>(d);
+         return *this;
+      }
+
+   private:
+      time_point at_;
+};
+
+/*!
+ * Add a function to cron with a std::chrono period (and phase).
+ * The phase may use its own duration type, e.g. milliseconds against a
+ * seconds period.
+ * \return  0 on success, -1 on invalid arguments or a full table
+ * \sa ::service_add_ex()
+ */
+template <class Clock, class Rep, class Period, class Rep2 = Rep, class Period2 = Period>
+inline int service_add (cronfun_t pfun, std::chrono::duration<Rep, Period> period,
+                        std::chrono::duration<Rep2, Period2> phase = std::chrono::duration<Rep2, Period2>::zero (),
+                        uint8_t flags = 0) {
+   return ::service_add_ex (pfun, ticks<Clock>(period), ticks<Clock>(phase), flags);
+}
+
+#if USYS_FREQ
+//! The usys clock at the compile time frequency \ref USYS_FREQ
+using clock = basic_clock<USYS_FREQ>;
+#endif
+
+}  // namespace usys
+
+#endif // #ifndef __usystime_hpp__
@@ -0,0 +1,123 @@
+/*
+ * \file usystrace.h
+ * \brief
+ *    Binary trace log. Fixed size records with a timestamp in a lock-free
+ *    ring, for tracing at high event rates without format parsing.
+ * Provides:
+ *    usys_trace(), usys_trace_read()
+ * \note
+ *    Any context can write records, including SysTick_Callback(), the
+ *    cron services and nested ISRs: a slot is reserved with a compare and
+ *    swap and published by its sequence number. The ring keeps the newest
+ *    records, the reader counts the overwritten ones. The application
+ *    sends the records to the host as they are (for ex: with _write() or a
+ *    debugger memory dump) and tools/usys_tracedec decodes them.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __usystrace_h__
+#define __usystrace_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * ======= User defines =============
+ */
+
+/*!
+ * Trace log. When 0, usys_trace() compiles to nothing.
+ */
+#ifndef USYS_TRACE
+#define USYS_TRACE                (0)
+#endif
+
+/*!
+ * Number of records in the trace ring
+ * \note
+ *    Must be a power of 2
+ */
+#ifndef USYS_TRACE_SIZE
+#define USYS_TRACE_SIZE           (256)
+#endif
+
+/*!
+ * Record timestamp. The default is the high resolution clock in cycles if
+ * enabled, or the mclock() ticks otherwise.
+ */
+#ifndef USYS_TRACE_STAMP
+#if USYS_HIRES_CLOCK
+#define USYS_TRACE_STAMP()        ((uint32_t)usys_cycles ())
+#else
+#define USYS_TRACE_STAMP()        ((uint32_t)mclock ())
+#endif
+#endif
+
+/*!
+ * Trace the scheduler. Each cron service call writes a
+ * \ref USYS_TRACE_ID_SERVICE record with the service address.
+ */
+#ifndef USYS_TRACE_SCHED
+#define USYS_TRACE_SCHED          (0)
+#endif
+
+/*
+ * ===== Data types ========
+ */
+
+/*
+ * Trace ids used by usys. The application uses the ids below them.
+ */
+#define  USYS_TRACE_ID_SERVICE    (0xFF00)    /*!< A cron service runs, arg: its address */
+#define  USYS_TRACE_ID_LOST       (0xFFFF)    /*!< Written by usys_trace_read(), arg: records lost */
+
+/*!
+ * Trace record. 16 bytes in the target's byte order, the same on the wire.
+ */
+typedef struct {
+   uint32_t    seq;     /*!< Sequence number + 1, written last. 0 while empty */
+   uint32_t    stamp;   /*!< \ref USYS_TRACE_STAMP() */
+   uint16_t    id;      /*!< Event id */
+   uint16_t    res;     /*!< Reserved, 0 */
+   uint32_t    arg;     /*!< Event argument */
+}usys_trace_rec_t;
+
+/*
+ * ===== Public API ========
+ */
+#if USYS_TRACE
+#if (USYS_TRACE_SIZE & (USYS_TRACE_SIZE - 1))
+#error "USYS_TRACE_SIZE must be a power of 2"
+#endif
+#define  usys_trace(_id_, _arg_)    usys_trace_put ((uint16_t)(_id_), (uint32_t)(_arg_))
+
+void usys_trace_put (uint16_t id, uint32_t arg);
+uint32_t usys_trace_read (usys_trace_rec_t *dst, uint32_t n);
+#else
+#define  usys_trace(_id_, _arg_)    ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // #ifndef __usystrace_h__
@@ -0,0 +1,71 @@
+/*
+ * \file usys_sim.c
+ * \brief
+ *    Fake HAL of the host simulation build. It provides the externs usys
+ *    expects from a port, backed by plain variables that the host program
+ *    can drive.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <usys_sim.h>
+
+clock_t usys_sim_freq = 1000;
+uint64_t usys_sim_tx_bytes = 0;
+
+clock_t get_freq (void) {
+   return usys_sim_freq;
+}
+
+int set_freq (clock_t sf) {
+   usys_sim_freq = sf;
+   return 0;
+}
+
+#if USYS_TICKLESS
+clock_t usys_sim_compare = 0;
+
+void set_compare (clock_t dt) {
+   usys_sim_compare = dt;
+}
+#endif
+
+#if USYS_HIRES_CLOCK
+uint32_t usys_sim_count = 0;
+uint32_t usys_sim_reload = 999;
+int usys_sim_pending = 0;
+
+uint32_t get_count (void)  { return usys_sim_count; }
+uint32_t get_reload (void) { return usys_sim_reload; }
+int get_pending (void)      { return usys_sim_pending; }
+#endif
+
+#if USYS_TX_RING_SIZE
+/*!
+ * An infinitely fast transmitter, drains the whole ring
+ */
+void usys_tx_kick (void) {
+   const uint8_t *p;
+   uint32_t n;
+
+   while ((n = usys_ring_peek (&usys_tx, &p))) {
+      usys_ring_consume (&usys_tx, n);
+      usys_sim_tx_bytes += n;
+   }
+}
+#endif
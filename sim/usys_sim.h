@@ -0,0 +1,48 @@
+/*
+ * \file usys_sim.h
+ * \brief
+ *    Fake HAL of the host simulation build
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __usys_sim_h__
+#define __usys_sim_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <usys.h>
+
+extern clock_t usys_sim_freq;             /*!< Time base frequency returned by get_freq() */
+extern uint64_t usys_sim_tx_bytes;        /*!< Bytes drained from usys_tx by usys_tx_kick() */
+#if USYS_TICKLESS
+extern clock_t usys_sim_compare;          /*!< Last set_compare() request */
+#endif
+#if USYS_HIRES_CLOCK
+extern uint32_t usys_sim_count;           /*!< Value of the fake tick down-counter */
+extern uint32_t usys_sim_reload;          /*!< Reload value of the fake tick down-counter */
+extern int usys_sim_pending;              /*!< The fake tick interrupt is pending */
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // #ifndef __usys_sim_h__
@@ -24,14 +24,30 @@
 
 /* Includes */
 #include <syscalls.h>
+#include <usystime.h>
+#include <usysport.h>
+#include <string.h>
 
 
 /* Variables */
+#if !USYS_SIM
 #undef errno
 extern int32_t errno;
 
 uint8_t *__env[1] = { 0 };
 uint8_t **environ = __env;
+#endif
+
+#if USYS_TX_RING_SIZE
+static uint8_t _tx_buf[USYS_TX_RING_SIZE];
+usys_ring_t usys_tx = USYS_RING_INIT (_tx_buf);
+volatile uint32_t usys_tx_dropped = 0;
+#endif
+
+#if USYS_RX_RING_SIZE
+static uint8_t _rx_buf[USYS_RX_RING_SIZE];
+usys_ring_t usys_rx = USYS_RING_INIT (_rx_buf);
+#endif
 
 
 /* Functions */
@@ -45,48 +61,538 @@ uint8_t **environ = __env;
    return -1;                  \
 }
 
+#define  __fail(_e_)          { errno = (_e_); return -1; }
+
+// Modes of each syscalls group, see USYS_SC_xxx. The rings are stdio only
+#if USYS_SC_STDIO < USYS_SC_NONE || USYS_SC_STDIO > USYS_SC_WEAK
+#error "USYS_SC_STDIO: use USYS_SC_NONE, USYS_SC_MINIMAL, USYS_SC_RING or USYS_SC_WEAK"
+#endif
+#if USYS_SC_FILE != USYS_SC_NONE && USYS_SC_FILE != USYS_SC_MINIMAL && USYS_SC_FILE != USYS_SC_WEAK
+#error "USYS_SC_FILE: use USYS_SC_NONE, USYS_SC_MINIMAL or USYS_SC_WEAK"
+#endif
+#if USYS_SC_PROC != USYS_SC_NONE && USYS_SC_PROC != USYS_SC_MINIMAL && USYS_SC_PROC != USYS_SC_WEAK
+#error "USYS_SC_PROC: use USYS_SC_NONE, USYS_SC_MINIMAL or USYS_SC_WEAK"
+#endif
+#if USYS_SC_TIME != USYS_SC_NONE && USYS_SC_TIME != USYS_SC_MINIMAL && USYS_SC_TIME != USYS_SC_WEAK
+#error "USYS_SC_TIME: use USYS_SC_NONE, USYS_SC_MINIMAL or USYS_SC_WEAK"
+#endif
+
+// Linkage of each syscalls group, see USYS_SC_xxx
+#if USYS_SC_STDIO == USYS_SC_WEAK
+#define  __sc_stdio           __weak
+#else
+#define  __sc_stdio
+#endif
+#if USYS_SC_FILE == USYS_SC_WEAK
+#define  __sc_file            __weak
+#else
+#define  __sc_file
+#endif
+#if USYS_SC_PROC == USYS_SC_WEAK
+#define  __sc_proc            __weak
+#else
+#define  __sc_proc
+#endif
+#if USYS_SC_TIME == USYS_SC_WEAK
+#define  __sc_time            __weak
+#else
+#define  __sc_time
+#endif
+
+//! The stdio ring backends are in use
+#define  _SC_RINGS            (USYS_SC_STDIO == USYS_SC_RING || USYS_SC_STDIO == USYS_SC_WEAK)
+
 
 void initialise_monitor_handles() {
 }
 
+#if !USYS_SIM
 void _exit (int32_t status) {
    __use_1 (status);
    while (1) {}      /* Make sure we hang here */
 }
+#endif
+
+#if USYS_SC_STDIO != USYS_SC_NONE
+#if USYS_TX_RING_SIZE && _SC_RINGS
+/*!
+ * ring buffered _write, used by puts and printf. It copies the data into
+ * \ref usys_tx and kicks the port's transmitter, so it does not wait for
+ * the line.
+ */
+__sc_stdio int _write (int32_t file, uint8_t *ptr, int32_t len) {
+   uint32_t n = 0;
 
+   __use_1(file);
+   if (len <= 0)
+      return 0;
+   do {
+      n += usys_ring_write (&usys_tx, ptr + n, (uint32_t)len - n);
+      usys_tx_kick ();
+   } while (USYS_TX_POLICY == USYS_TX_BLOCK && n < (uint32_t)len);
+   usys_tx_dropped += (uint32_t)len - n;
+   return len;       // Report all, or newlib retries the dropped part
+}
+#elif USYS_SC_STDIO == USYS_SC_WEAK
 /* Implement your write code here, this is used by puts and printf for example */
 /* return len; */
 __weak int _write (int32_t file, uint8_t *ptr, int32_t len) {
    __use_3(file, *ptr, len);
    __not_implemented();
 }
+#else
+/*!
+ * Minimal _write, there is no output. Drops the data.
+ */
+int _write (int32_t file, uint8_t *ptr, int32_t len) {
+   __use_2(file, *ptr);
+   return len;
+}
+#endif
+#endif   // #if USYS_SC_STDIO != USYS_SC_NONE
+
+#if USYS_SIM
+static uint64_t _sim_heap[USYS_SIM_HEAP_SIZE / sizeof (uint64_t)];
+static char * heap_start = (char *)_sim_heap;   //!< The program break
+static char * const heap_base = (char *)_sim_heap;    //!< Start of the heap
+#else
+static char * heap_start = 0;                   //!< The program break, 0 until the first _sbrk()
+static char * heap_base = 0;                    //!< Start of the heap
+#endif
+#if USYS_MEMMON
+static char * volatile heap_max = 0;            //!< Highest program break
+#endif
 
+/*!
+ * Moves the program break. The heap starts after _ebss and ends at the
+ * linker's _heap_end if there is one, or USYS_STACK_MARGIN bytes below
+ * the current stack pointer otherwise. In the \ref USYS_SIM build it is a
+ * static array.
+ * \return
+ *    The previous break, or (void*)-1 and errno ENOMEM if the heap would
+ *    cross its end or shrink below its start.
+ */
 void * _sbrk(int32_t incr) {
-	extern unsigned long   _ebss;    /* Set by linker.  */
-	static char * heap_start = 0;
-	char * ret;
+#if USYS_SIM
+   char * ret, * end = (char *)_sim_heap + sizeof (_sim_heap);
+#else
+   extern unsigned long   _ebss;    /* Set by linker.  */
+   extern char _heap_end __attribute__ ((weak));   /* Set by linker, optional */
+   char * ret, * end;
 
-	if (heap_start == 0) {
-	   // Run the first time only to initialize heap_start
-	   heap_start = (char *)(&_ebss + sizeof (unsigned long));
-	}
+   if (heap_start == 0) {
+      // Run the first time only to initialize heap_start (8 byte aligned)
+      heap_start = (char *)(&_ebss + sizeof (unsigned long));
+      heap_start = (char *)(((uintptr_t)heap_start + 7) & ~(uintptr_t)7);
+      heap_base = heap_start;
+   }
+   end = (&_heap_end) ? &_heap_end : usys_sp () - USYS_STACK_MARGIN;
+#endif
+   if ((incr > 0 && incr > end - heap_start)
+    || (incr < 0 && -(intptr_t)incr > heap_start - heap_base)) {
+      errno = ENOMEM;
+      return (void *) -1;
+   }
 
-	// Return the entry value of heap_start
-	ret = heap_start;
-	heap_start += incr;
+   // Return the entry value of heap_start
+   ret = heap_start;
+   heap_start += incr;
+#if USYS_MEMMON
+   if (heap_start > heap_max)
+      heap_max = heap_start;
+#endif
 
-	return (void *) ret;
+   return (void *) ret;
 }
 
-__weak int _getpid(void) { __not_implemented(); }
-__weak int _gettimeofday(struct timeval  *ptimeval, void *ptimezone) {
-   __use_2(*ptimeval, ptimezone);
-   __not_implemented();
+#if USYS_MEMMON
+/*
+ * Watermark monitor.
+ * The painted region is [_mm_base, _mm_top). The heap grows up into it and
+ * the stack down into it. The cron service moves a cursor upwards from the
+ * heap high-water mark, USYS_MEMMON_WORDS per run. The first word that lost
+ * the pattern is the deepest stack use, so the mark moves there and the scan
+ * starts over. This way each run costs a few reads and no run does a full
+ * scan.
+ */
+#define  _MEMMON_GUARD        (64)  //!< Unpainted bytes below the stack pointer of usys_memmon_init()
+#define  _word_up(_p_)        ((uint32_t *)(((uintptr_t)(_p_) + 3) & ~(uintptr_t)3))
+
+static uint32_t *_mm_base;                   //!< Start of the painted region
+static uint32_t *_mm_top;                    //!< End of the painted region
+static uint32_t * volatile _mm_stack;        //!< Lowest used stack word found
+static uint32_t *_mm_cur;                    //!< Scan cursor
+static volatile uint32_t _mm_passes;         //!< Complete scans
+
+/*!
+ * \brief
+ *    Monitor cron service. Checks up to USYS_MEMMON_WORDS words.
+ */
+static void _memmon_service (void)
+{
+   uint32_t *base = _word_up (heap_max);  // A trimmed heap leaves its data below the mark
+   uint32_t *p = _mm_cur, *end = _mm_stack;
+   uint32_t n;
+
+   if (base < _mm_base)
+      base = _mm_base;
+   if (p < base)
+      p = base;            // The heap grew over the cursor
+   for (n=0 ; n<USYS_MEMMON_WORDS ; ++n, ++p) {
+      if (p >= end) {
+         ++_mm_passes;     // Nothing new down to the mark
+         p = base;
+         break;
+      }
+      if (*p != (uint32_t)USYS_MEMMON_PATTERN) {
+         _mm_stack = p;    // The stack reached here, start over
+         p = base;
+         break;
+      }
+   }
+   _mm_cur = p;
+}
+
+/*!
+ * \brief
+ *    Paint the free RAM and start the monitor service. Call it once, early
+ *    at startup and from the main stack. The interrupts are masked while
+ *    painting, so no ISR frame lands in the painted area meanwhile.
+ * \return  0 on success, -1 if the crontab is full and the monitor service
+ *          could not be added. Then the watermarks are not updated.
+ */
+int usys_memmon_init (void)
+{
+   uint32_t *p, s;
+
+   _sbrk (0);              // Make sure the break is initialized
+   _mm_base = _word_up (heap_start);
+#if USYS_SIM
+   _mm_top = (uint32_t *)((char *)_sim_heap + sizeof (_sim_heap));
+#else
+   _mm_top = (uint32_t *)((uintptr_t)(usys_sp () - _MEMMON_GUARD) & ~(uintptr_t)3);
+#endif
+   if (_mm_top < _mm_base)
+      _mm_top = _mm_base;  // The stack is not above the heap, nothing to watch
+
+   s = usys_irq_save ();
+   for (p = _mm_base ; p < _mm_top ; ++p)
+      *(volatile uint32_t *)p = (uint32_t)USYS_MEMMON_PATTERN;
+   usys_irq_restore (s);
+
+   _mm_cur = _mm_base;
+   _mm_stack = _mm_top;
+   _mm_passes = 0;
+   return service_add_ex (_memmon_service, USYS_MEMMON_PERIOD, 0, USYS_SRV_STAGGER);
+}
+
+/*!
+ * \brief
+ *    Report the watermarks found so far. The stack mark is exact after a
+ *    complete scan of the region, see \a passes.
+ * \param   r     Pointer to return the report
+ */
+void usys_memmon_report (usys_memmon_t *r)
+{
+   uintptr_t h = (uintptr_t)heap_max, st = (uintptr_t)_mm_stack;
+
+   r->base = (uintptr_t)_mm_base;
+   r->top = (uintptr_t)_mm_top;
+   r->heap_max = (h > r->base) ? h : r->base;
+   r->stack_min = st;
+   r->free_min = (st > r->heap_max) ? (uint32_t)(st - r->heap_max) : 0;
+   r->passes = _mm_passes;
+}
+#endif   // #if USYS_MEMMON
+
+/*
+ * Fixed size object pool.
+ * The free list is a lock-free stack of object indexes. Each push and pop
+ * increments the tag at the upper half of the head, so a pop that was
+ * interrupted by a pop/push pair of the same object (ABA) fails its swap
+ * and retries. This makes the pools safe from SysTick context and
+ * cron services.
+ */
+#define  _POOL_IDX(_h_)       ((_h_) & 0xFFFF)
+#define  _POOL_TAG(_h_)       (((_h_) + 0x10000) & 0xFFFF0000)
+#define  _pool_obj(_p_, _i_)  ((uint32_t *)((_p_)->mem + ((_i_) - 1) * (_p_)->size))
+
+/*!
+ * \brief
+ *    Count an allocation and track the high water mark
+ */
+static void _pool_use (usys_pool_t *p) {
+   uint32_t u, m;
+   do
+      u = p->used;
+   while (!usys_cas (&p->used, u, u + 1));
+   do {
+      if ((m = p->hwm) > u)
+         break;
+   } while (!usys_cas (&p->hwm, m, u + 1));
+}
+
+/*!
+ * \brief
+ *    Allocate an object from a pool. Safe from interrupts.
+ * \param   p     Pointer to pool
+ * \return        Pointer to the object, or NULL if the pool is empty
+ */
+void *usys_pool_alloc (usys_pool_t *p)
+{
+   uint32_t h, i, n;
+
+   do {
+      h = p->head;
+      if (!(i = _POOL_IDX (h))) {
+         // Free list is empty, take a never used object
+         do {
+            if ((n = p->fresh) >= p->count)
+               return 0;
+         } while (!usys_cas (&p->fresh, n, n + 1));
+         i = n + 1;
+         break;
+      }
+      // The link may be stale if we get interrupted, the tag catches that
+   } while (!usys_cas (&p->head, h, _POOL_TAG (h) | *_pool_obj (p, i)));
+   _pool_use (p);
+   return _pool_obj (p, i);
+}
+
+/*!
+ * \brief
+ *    Return an object to its pool. Safe from interrupts.
+ * \param   p     Pointer to pool
+ * \param   obj   Pointer from usys_pool_alloc(). NULL is ignored
+ */
+void usys_pool_free (usys_pool_t *p, void *obj)
+{
+   uint32_t h, u, i;
+
+   if (!obj)
+      return;
+   i = (uint32_t)(((uint8_t *)obj - p->mem) / p->size) + 1;
+   do {
+      h = p->head;
+      *(uint32_t *)obj = _POOL_IDX (h);
+   } while (!usys_cas (&p->head, h, _POOL_TAG (h) | i));
+   do
+      u = p->used;
+   while (!usys_cas (&p->used, u, u - 1));
+}
+
+#if USYS_HEAP
+/*!
+ * usys heap block header. It keeps the payload 8 byte aligned. While the
+ * block is free, the payload holds the free list link.
+ */
+typedef struct {
+   uint32_t    cls;     //!< Size class, or _HEAP_LARGE
+   uint32_t    size;    //!< Payload capacity in bytes
+} _hblk_t;
+
+#define  _HEAP_LARGE    (USYS_HEAP_CLASSES)
+#define  _HEAP_MIN      (8)                  //!< Class 0 block size
+#define  _hblk(_p_)     ((_hblk_t *)(_p_) - 1)
+#define  _hnext(_b_)    (*(_hblk_t **)((_b_) + 1))
+
+static _hblk_t *_heap_free[USYS_HEAP_CLASSES + 1];  //!< Free lists, the last is for large blocks
+
+/*!
+ * \brief
+ *    Size class of a request, in O(1)
+ */
+static uint32_t _heap_class (size_t size) {
+   if (size <= _HEAP_MIN)
+      return 0;
+   if (size > (size_t)_HEAP_MIN << (USYS_HEAP_CLASSES - 1))
+      return _HEAP_LARGE;
+   return 32 - usys_clz ((uint32_t)size - 1) - 3;
+}
+
+/*!
+ * \brief
+ *    Allocate memory from the usys heap.
+ * \param   size  The requested size in bytes
+ * \return        Pointer to the memory, or NULL with errno ENOMEM
+ */
+void *usys_malloc (size_t size)
+{
+   uint32_t c;
+   _hblk_t *b, **pp;
+
+   if (size > INT32_MAX - sizeof (_hblk_t) - 7) {
+      errno = ENOMEM;      // Would not fit in the _sbrk() increment
+      return 0;
+   }
+   c = _heap_class (size);
+
+   if (c != _HEAP_LARGE) {
+      if ((b = _heap_free[c]) != 0) {
+         _heap_free[c] = _hnext (b);      // O(1) reuse
+         return b + 1;
+      }
+      size = (size_t)_HEAP_MIN << c;
+   }
+   else {
+      // First fit among the freed large blocks
+      for (pp = &_heap_free[_HEAP_LARGE] ; (b = *pp) ; pp = &_hnext (b))
+         if (b->size >= size) {
+            *pp = _hnext (b);
+            return b + 1;
+         }
+      size = (size + 7) & ~(size_t)7;
+   }
+   if ((b = _sbrk ((int32_t)(sizeof (_hblk_t) + size))) == (void *) -1)
+      return 0;   // errno is already ENOMEM
+   b->cls = c;
+   b->size = (uint32_t)size;
+   return b + 1;
+}
+
+/*!
+ * \brief
+ *    Return memory to its size class free list, in O(1)
+ * \param   ptr   Pointer from usys_malloc(). NULL is ignored
+ */
+void usys_free (void *ptr)
+{
+   _hblk_t *b;
+
+   if (!ptr)
+      return;
+   b = _hblk (ptr);
+   _hnext (b) = _heap_free[b->cls];
+   _heap_free[b->cls] = b;
+}
+
+/*!
+ * \brief
+ *    Resize a usys heap allocation. The block is kept if it is big enough.
+ */
+void *usys_realloc (void *ptr, size_t size)
+{
+   void *n;
+
+   if (!ptr)
+      return usys_malloc (size);
+   if (!size) {
+      usys_free (ptr);
+      return 0;
+   }
+   if (_hblk (ptr)->size >= size)
+      return ptr;
+   if ((n = usys_malloc (size)) != 0) {
+      memcpy (n, ptr, _hblk (ptr)->size);
+      usys_free (ptr);
+   }
+   return n;
+}
+
+/*!
+ * \brief
+ *    Allocate zeroed memory for an array from the usys heap
+ */
+void *usys_calloc (size_t n, size_t size)
+{
+   void *p;
+
+   if (size && n > (size_t)-1 / size) {
+      errno = ENOMEM;
+      return 0;
+   }
+   if ((p = usys_malloc (n * size)) != 0)
+      memset (p, 0, n * size);
+   return p;
 }
+
+#if !USYS_SIM
+/*
+ * newlib allocator hooks. They keep newlib's malloc lock, so ports with an
+ * RTOS lock keep working.
+ */
+struct _reent;
+extern void __malloc_lock (struct _reent *r);
+extern void __malloc_unlock (struct _reent *r);
+
+void *_malloc_r (struct _reent *r, size_t size) {
+   void *p;
+   __malloc_lock (r);
+   p = usys_malloc (size);
+   __malloc_unlock (r);
+   return p;
+}
+
+void _free_r (struct _reent *r, void *ptr) {
+   __malloc_lock (r);
+   usys_free (ptr);
+   __malloc_unlock (r);
+}
+
+void *_realloc_r (struct _reent *r, void *ptr, size_t size) {
+   void *p;
+   __malloc_lock (r);
+   p = usys_realloc (ptr, size);
+   __malloc_unlock (r);
+   return p;
+}
+
+void *_calloc_r (struct _reent *r, size_t n, size_t size) {
+   void *p;
+   __malloc_lock (r);
+   p = usys_calloc (n, size);
+   __malloc_unlock (r);
+   return p;
+}
+#endif   // #if !USYS_SIM
+#endif   // #if USYS_HEAP
+
+/*
+ * ======== Process syscalls ========
+ */
+#if USYS_SC_PROC == USYS_SC_WEAK
+__weak int _getpid(void) { __not_implemented(); }
 __weak int _kill(int32_t pid, int32_t sig)  {
    __use_2(pid, sig);
    __not_implemented();
 }
+__weak int _wait(int32_t *status) { __use_1 (*status); __not_implemented(); }
+__weak int _times(struct tms *buf) { __use_1(*buf); __not_implemented(); }
+__weak int _fork(void) { __not_implemented(); }
+__weak int _execve(const uint8_t *name, uint8_t * const *argv, uint8_t * const *env) {
+   __use_3 (*name, *argv, *env);
+   __not_implemented();
+}
+#elif USYS_SC_PROC == USYS_SC_MINIMAL
+int _getpid(void) { return 1; }
+int _kill(int32_t pid, int32_t sig)  {
+   __use_2(pid, sig);
+   __fail (EINVAL);
+}
+int _wait(int32_t *status) { __use_1 (*status); __fail (ECHILD); }
+int _times(struct tms *buf) { __use_1(*buf); __fail (ENOSYS); }
+int _fork(void) { __fail (EAGAIN); }
+int _execve(const uint8_t *name, uint8_t * const *argv, uint8_t * const *env) {
+   __use_3 (*name, *argv, *env);
+   __fail (ENOMEM);
+}
+#endif
+
+/*
+ * ======== Time syscalls ========
+ */
+#if USYS_SC_TIME != USYS_SC_NONE
+__sc_time int _gettimeofday(struct timeval  *ptimeval, void *ptimezone) {
+   if (usys_gettimeofday (ptimeval, ptimezone))
+      __fail (EFAULT);     // No timeval to fill
+   return 0;
+}
+#endif
+
+/*
+ * ======== File syscalls ========
+ */
+#if USYS_SC_FILE == USYS_SC_WEAK
 __weak int _close(int32_t file) { __use_1(file); __not_implemented(); }
 __weak int _fstat(int32_t file, struct stat *st) { __use_2(file, *st); __not_implemented(); }
 __weak int _isatty(int32_t file) { __use_1(file); __not_implemented(); }
@@ -94,10 +600,6 @@ __weak int _lseek(int32_t file, int32_t ptr, int32_t dir) {
    __use_3(file, ptr, dir);
    __not_implemented();
 }
-__weak int _read(int32_t file, uint8_t *ptr, int32_t len) {
-   __use_3(file, *ptr, len);
-   __not_implemented();
-}
 __weak int _readlink(const char *path, char *buf, size_t bufsize) {
    __use_3(*path, *buf, bufsize);
    __not_implemented();
@@ -106,9 +608,7 @@ __weak int _open(const uint8_t *path, int32_t flags, int32_t mode) {
    __use_3 (*path, flags, mode);
    __not_implemented();
 }
-__weak int _wait(int32_t *status) { __use_1 (*status); __not_implemented(); }
 __weak int _unlink(const uint8_t *name) { __use_1(*name); __not_implemented(); }
-__weak int _times(struct tms *buf) { __use_1(*buf); __not_implemented(); }
 __weak int _stat(const uint8_t *file, struct stat *st) {
    __use_2(*file, *st);
    __not_implemented();
@@ -121,11 +621,79 @@ __weak int _link(const uint8_t *old, const uint8_t *new) {
    __use_2(*old, *new);
    __not_implemented();
 }
-__weak int _fork(void) { __not_implemented(); }
-__weak int _execve(const uint8_t *name, uint8_t * const *argv, uint8_t * const *env) {
-   __use_3 (*name, *argv, *env);
+#elif USYS_SC_FILE == USYS_SC_MINIMAL
+int _close(int32_t file) { __use_1(file); __fail (EBADF); }
+int _fstat(int32_t file, struct stat *st) {
+   __use_1(file);
+   st->st_mode = S_IFCHR;
+   return 0;
+}
+int _isatty(int32_t file) { __use_1(file); return 1; }
+int _lseek(int32_t file, int32_t ptr, int32_t dir) {
+   __use_3(file, ptr, dir);
+   return 0;
+}
+int _readlink(const char *path, char *buf, size_t bufsize) {
+   __use_3(*path, *buf, bufsize);
+   __fail (ENOENT);
+}
+int _open(const uint8_t *path, int32_t flags, int32_t mode) {
+   __use_3 (*path, flags, mode);
+   __fail (ENOENT);
+}
+int _unlink(const uint8_t *name) { __use_1(*name); __fail (ENOENT); }
+int _stat(const uint8_t *file, struct stat *st) {
+   __use_1(*file);
+   st->st_mode = S_IFCHR;
+   return 0;
+}
+int _symlink(const char *path1, const char *path2)  {
+   __use_2(*path1, *path2);
+   __fail (EMLINK);
+}
+int _link(const uint8_t *old, const uint8_t *new) {
+   __use_2(*old, *new);
+   __fail (EMLINK);
+}
+#endif
+
+/*
+ * ======== stdio input ========
+ */
+#if USYS_SC_STDIO != USYS_SC_NONE
+#if USYS_RX_RING_SIZE && _SC_RINGS
+/*!
+ * ring buffered _read, used by getchar and scanf for example. It copies
+ * the contiguous spans out of \ref usys_rx. Zero copy consumers can use
+ * usys_ring_peek()/usys_ring_consume() on usys_rx instead.
+ * \note
+ *    It waits for at least one byte, as 0 means end of file to libc.
+ */
+__sc_stdio int _read(int32_t file, uint8_t *ptr, int32_t len) {
+   uint32_t n;
+
+   __use_1(file);
+   if (len <= 0)
+      return 0;
+   while (!(n = usys_ring_read (&usys_rx, ptr, (uint32_t)len)))
+      ;
+   return (int)n;
+}
+#elif USYS_SC_STDIO == USYS_SC_WEAK
+__weak int _read(int32_t file, uint8_t *ptr, int32_t len) {
+   __use_3(file, *ptr, len);
    __not_implemented();
 }
+#else
+/*!
+ * Minimal _read, there is no input. Always end of file.
+ */
+int _read(int32_t file, uint8_t *ptr, int32_t len) {
+   __use_3(file, *ptr, len);
+   return 0;
+}
+#endif
+#endif   // #if USYS_SC_STDIO != USYS_SC_NONE
 
 #ifdef  USE_FULL_ASSERT
 
@@ -146,6 +714,7 @@ void assert_failed(uint8_t* file, uint32_t line)
 }
 #endif
 
+#if !USYS_SIM
 /*!
  * Minimal __assert_func used by the assert() macro
  */
@@ -160,3 +729,4 @@ void __assert_func (const char *file, int line, const char *func, const char *fa
 void __assert(const char *file, int line, const char *failedexpr) {
    __assert_func (file, line, NULL, failedexpr);
 }
+#endif
@@ -0,0 +1,201 @@
+/*
+ * \file usysring.c
+ * \brief
+ *    Lock-free single producer, single consumer byte ring buffer.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <usysring.h>
+#include <usysport.h>
+#include <string.h>
+
+/*!
+ * \brief
+ *    Initialize a ring buffer
+ * \param   r     Pointer to ring
+ * \param   buf   Pointer to the storage
+ * \param   size  Storage size. Must be a power of 2
+ */
+void usys_ring_init (usys_ring_t *r, uint8_t *buf, uint32_t size) {
+   r->buf = buf;
+   r->size = size;
+   r->head = r->tail = 0;
+   r->lost = 0;
+}
+
+/*!
+ * \brief
+ *    Get the number of bytes waiting in the ring
+ */
+uint32_t usys_ring_count (const usys_ring_t *r) {
+   uint32_t n = r->head - r->tail;
+   return (n < r->size) ? n : r->size;    // Lapped by usys_ring_dma_pos()
+}
+
+/*!
+ * \brief
+ *    Get the free space of the ring
+ */
+uint32_t usys_ring_free (const usys_ring_t *r) {
+   return r->size - usys_ring_count (r);
+}
+
+/*!
+ * \brief
+ *    Copy data into the ring. Copies as much as it fits.
+ * \param   r     Pointer to ring
+ * \param   src   Pointer to data
+ * \param   len   Data size
+ * \return        The number of bytes written
+ */
+uint32_t usys_ring_write (usys_ring_t *r, const uint8_t *src, uint32_t len)
+{
+   uint32_t h = r->head, t = r->tail, i, c;
+
+   // One snapshot of the tail, so a consumer that moves it meanwhile can
+   // not raise the clamp above the caller's length
+   if (len > r->size - (h - t))
+      len = r->size - (h - t);
+   i = h & (r->size - 1);
+   c = r->size - i;     // contiguous space up to the end of storage
+   if (c > len)   c = len;
+   usys_barrier ();     // Read tail before we overwrite the storage
+   memcpy (&r->buf[i], src, c);
+   memcpy (r->buf, src + c, len - c);
+   usys_barrier ();     // Publish the data before the index
+   r->head = h + len;
+   return len;
+}
+
+/*!
+ * \brief
+ *    Get the contiguous free span of the ring, for a producer (ex: DMA)
+ *    that writes directly into the storage. Commit with usys_ring_produce().
+ * \param   r     Pointer to ring
+ * \param   p     Pointer to return the span
+ * \return        The span size
+ */
+uint32_t usys_ring_span (usys_ring_t *r, uint8_t **p)
+{
+   uint32_t h = r->head, t = r->tail;
+   uint32_t i = h & (r->size - 1);
+   uint32_t n = r->size - (h - t);
+
+   *p = &r->buf[i];
+   return (n < r->size - i) ? n : r->size - i;
+}
+
+/*!
+ * \brief
+ *    Commit \a n bytes written directly into the ring storage
+ */
+void usys_ring_produce (usys_ring_t *r, uint32_t n) {
+   usys_barrier ();
+   r->head = r->head + n;
+}
+
+/*!
+ * \brief
+ *    Update the ring from a circular DMA that uses the ring storage as its
+ *    buffer. The DMA is the producer and usys only follows its position.
+ * \note
+ *    The DMA does not see the tail, so the consumer has to keep up with it.
+ *    Data older than one storage size is overwritten. Then the tail moves
+ *    to the oldest byte still in the storage and \a lost counts the rest.
+ * \param   r     Pointer to ring
+ * \param   pos   The next index the DMA will write (ex: size - NDTR)
+ */
+void usys_ring_dma_pos (usys_ring_t *r, uint32_t pos) {
+   uint32_t h = r->head, t = r->tail;
+
+   h += (pos - h) & (r->size - 1);
+   if (h - t > r->size) {
+      r->lost = r->lost + (h - t - r->size);
+      r->tail = h - r->size;     // Drop the overwritten bytes
+   }
+   usys_barrier ();
+   r->head = h;
+}
+
+/*!
+ * \brief
+ *    Get the tail of the consumer, skipping the bytes an overrun of
+ *    usys_ring_dma_pos() overwrote meanwhile
+ */
+static uint32_t _ring_tail (usys_ring_t *r, uint32_t h) {
+   uint32_t t = r->tail;
+   return (h - t > r->size) ? h - r->size : t;
+}
+
+/*!
+ * \brief
+ *    Copy data out of the ring.
+ * \param   r     Pointer to ring
+ * \param   dst   Pointer to the destination buffer
+ * \param   len   Destination size
+ * \return        The number of bytes read
+ */
+uint32_t usys_ring_read (usys_ring_t *r, uint8_t *dst, uint32_t len)
+{
+   uint32_t h = r->head, t = _ring_tail (r, h), i, c;
+
+   // One snapshot of the head, the clamp and the copy use the same one
+   if (len > h - t)
+      len = h - t;
+   i = t & (r->size - 1);
+   c = r->size - i;
+   if (c > len)   c = len;
+   usys_barrier ();     // Read head before the data
+   memcpy (dst, &r->buf[i], c);
+   memcpy (dst + c, r->buf, len - c);
+   usys_barrier ();     // Finish reading before we release the space
+   r->tail = t + len;
+   return len;
+}
+
+/*!
+ * \brief
+ *    Get the contiguous readable span of the ring, for a zero copy
+ *    consumer (ex: DMA). Release it with usys_ring_consume().
+ * \param   r     Pointer to ring
+ * \param   p     Pointer to return the span
+ * \return        The span size
+ */
+uint32_t usys_ring_peek (usys_ring_t *r, const uint8_t **p)
+{
+   uint32_t h = r->head;
+   uint32_t t = _ring_tail (r, h);
+   uint32_t i = t & (r->size - 1);
+   uint32_t n = h - t;
+
+   if (t != r->tail)
+      r->tail = t;         // Lapped, usys_ring_consume() counts from here
+   usys_barrier ();
+   *p = &r->buf[i];
+   return (n < r->size - i) ? n : r->size - i;
+}
+
+/*!
+ * \brief
+ *    Release \a n bytes of a span returned by usys_ring_peek()
+ */
+void usys_ring_consume (usys_ring_t *r, uint32_t n) {
+   usys_barrier ();
+   r->tail = r->tail + n;
+}
@@ -0,0 +1,182 @@
+/*
+ * \file usystask.c
+ * \brief
+ *    Cooperative stackless tasks (protothreads) on top of the usys time
+ *    base.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <usystask.h>
+#include <usysport.h>
+#include <stddef.h>
+
+/*
+ * ============ Static Data ============
+ */
+static usys_task_t *_tasks = NULL;     //!< Started tasks, in start order
+
+/*
+ * ============ Static API ============
+ */
+
+#if USYS_TIMERS
+/*!
+ * \brief
+ *    Timer callback of the delays. Runs from the SysTick ISR.
+ */
+static void _task_timer (void *arg) {
+   ((usys_task_t *)arg)->ready = 1;
+}
+#endif
+
+/*!
+ * \brief
+ *    Remove a task from the task list
+ * \return  Non zero if it was there
+ */
+static int _task_unlink (usys_task_t *t)
+{
+   usys_task_t **pp;
+
+   for (pp = &_tasks ; *pp ; pp = &(*pp)->next)
+      if (*pp == t) {
+         *pp = t->next;
+         t->next = NULL;
+         return 1;
+      }
+   return 0;
+}
+
+/*
+ * ============ Public API ============
+ */
+
+/*!
+ * \brief
+ *    Start (or restart from its beginning) a task. It runs on the next
+ *    usys_task_run().
+ * \note
+ *    Call it from thread context, not from an ISR.
+ * \param   t     Pointer to the User's task object
+ * \param   fun   The task function
+ * \param   arg   The task argument, see usys_task_arg()
+ */
+void usys_task_start (usys_task_t *t, taskfun_t fun, void *arg)
+{
+   usys_task_t **pp;
+
+   usys_task_stop (t);
+   t->fun = fun;
+   t->arg = arg;
+   t->lc = 0;
+   t->dl = 0;
+#if USYS_TIMERS
+   usys_timer_init (&t->tmr, _task_timer, t, 0);
+#endif
+   for (pp = &_tasks ; *pp ; pp = &(*pp)->next)
+      ;
+   *pp = t;
+   t->ready = 1;
+}
+
+/*!
+ * \brief
+ *    Stop a task. It does not run again, unless started again.
+ * \note
+ *    Call it from thread context, not from an ISR. A task can stop itself.
+ */
+void usys_task_stop (usys_task_t *t)
+{
+   if (!_task_unlink (t))
+      return;
+   t->ready = 0;
+#if USYS_TIMERS
+   usys_timer_stop (&t->tmr);
+#endif
+}
+
+/*!
+ * \brief
+ *    Make a task run on the next usys_task_run(). Safe from any context,
+ *    for ex: from an ISR that a USYS_TASK_WAIT_EVENT() waits for.
+ */
+void usys_task_wake (usys_task_t *t) {
+   t->ready = 1;
+}
+
+/*!
+ * \brief
+ *    Set the deadline of a task's delay and arm its wake up timer.
+ *    Used by USYS_TASK_WAIT_DEADLINE() and USYS_TASK_DELAY().
+ * \param   t     Pointer to task
+ * \param   dl    The mclock() deadline
+ */
+void usys_task_sleep (usys_task_t *t, mclock_t dl)
+{
+   t->dl = dl;
+#if USYS_TIMERS
+   if (!usys_expired (dl))
+      usys_timer_start (&t->tmr, (clock_t)(dl - mclock ()), 0);
+#endif
+}
+
+/*!
+ * \brief
+ *    Return code of a task blocked on its delay. Without a wake up timer
+ *    (no \ref USYS_TIMERS, or all of them armed) the task polls.
+ */
+int usys_task_blocked (usys_task_t *t)
+{
+#if USYS_TIMERS
+   if (usys_timer_active (&t->tmr))
+      return USYS_TASK_WAITING;
+#else
+   (void)t;
+#endif
+   return USYS_TASK_READY;
+}
+
+/*!
+ * \brief
+ *    Run each ready task once, in start order. The User calls this from
+ *    the main loop.
+ *
+ * \return  The number of tasks that run. When 0, nothing is ready until
+ *          the next interrupt, so the caller may sleep.
+ */
+int usys_task_run (void)
+{
+   usys_task_t *t, *n;
+   int r, cnt = 0;
+
+   for (t = _tasks ; t ; t = n) {
+      n = t->next;      // The task may stop itself
+      if (!t->ready)
+         continue;
+      t->ready = 0;     // Clear before the run, so a wake up is not lost
+      usys_barrier ();
+      ++cnt;
+      r = t->fun (t);
+      if (r == USYS_TASK_DONE)
+         usys_task_stop (t);
+      else if (r == USYS_TASK_READY)
+         t->ready = 1;
+   }
+   return cnt;
+}
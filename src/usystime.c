@@ -24,33 +24,736 @@
  *
  */
 #include <usystime.h>
+#include <usysport.h>
+#include <usystrace.h>
+#include <string.h>
 
 /*
  * ================== Static Data =======================
  */
-static clock_t volatile __ticks;       //!< CPU time
-static sclock_t volatile  __sticks;    //!< signed CPU time
-static time_t  volatile __now;         //!< Time in UNIX seconds past 1-Jan-70
+/*!
+ * The time base state. The tick reads and writes one cache line.
+ * clock() and sclock() are offsets over the monotonic count, so the tick
+ * increments a single counter and setclock()/setsclock() do not touch it.
+ */
+usys_tbase_t __usys_tbase __attribute__ ((aligned (USYS_CACHE_LINE))) = { .sec_cnt = 1 };
+
+#define  __mticks       (__usys_tbase.mticks)   //!< Monotonic CPU time. Not affected by setclock()
+#define  __now          (__usys_tbase.now)      //!< Time in UNIX seconds past 1-Jan-70
+#define  _sec_cnt       (__usys_tbase.sec_cnt)  //!< Ticks left until the next second of __now
+#ifdef _USYS_MTICKS_HI
+#define  _MTICKS_HI     (1)
+#define  __mticks_hi    (__usys_tbase.mticks_hi)   //!< High half of the 64-bit monotonic CPU time
+
+#if USYS_CPUS > 1
+/*!
+ * The other cores read the two halves while the primary core writes them,
+ * so the re-read of the high half is not enough. The writer makes
+ * \sa __mticks_seq odd during the update and the readers retry.
+ */
+static volatile uint32_t __mticks_seq;
+#define  _mticks_add(_n_)  do {                 \
+   ++__mticks_seq;                              \
+   usys_barrier ();                             \
+   if ((__mticks += (_n_)) < (_n_))             \
+      ++__mticks_hi;                            \
+   usys_barrier ();                             \
+   ++__mticks_seq;                              \
+} while (0)
+#else
+#define  _mticks_add(_n_)  do { if ((__mticks += (_n_)) < (_n_)) ++__mticks_hi; } while (0)
+#endif
+#else
+#define  _mticks_add(_n_)  (__mticks += (_n_))
+#endif
+static clock_t _freq;                  //!< Cached get_freq(), 0 until first read
+#if USYS_TIME_TRIM
+#define  _TRIM_MAX      (20000)        //!< Trim limit in ppm, keeps the fixed point in 32 bits
+static int32_t _trim;                  //!< Calendar trim in ppm
+static int32_t volatile _trim_q16;     //!< Trim in 1/65536 ticks per second
+static int32_t _trim_acc;              //!< Tick fraction carried to the next second, 1/65536 ticks
+static clock_t volatile _sec_len = 1;  //!< Ticks of the current second
+#if USYS_TIME_TRIM_LEARN
+static struct {
+   uint8_t     valid;
+   time_t      t;                      //!< Time set by the previous settime()
+   mclock_t    m;                      //!< mclock() at the previous settime()
+}_learn;
+#endif
+#endif
 
 static ext_time_ft _ext_time = NULL;         //!< Pointer to External time callback function
 static ext_settime_ft _ext_settime = NULL;   //!< Pointer to External set time callback function
+#if USYS_RTC_RESYNC
+static clock_t _rtc_cnt;               //!< Seconds left until the next RTC resync
+static volatile uint8_t _rtc_sync = 1; //!< The next time() reads the RTC
+#endif
 
 /*!<
  * \note
  *    The usys provides a time capability based on \sa __now which updated
  *    via the Systick time base. If the User application need a more accurate
  *    time system, it can use these pointers to link for example with an RTC
- *    time system.
+ *    time system. With \ref USYS_RTC_RESYNC the RTC value is cached in
+ *    \sa __now and read again only on every resync period.
  */
 
+#if (USYS_CRON_WHEEL_SLOTS & (USYS_CRON_WHEEL_SLOTS - 1))
+#error "USYS_CRON_WHEEL_SLOTS must be a power of 2"
+#endif
+#define  _WHEEL_MASK    (USYS_CRON_WHEEL_SLOTS - 1)
+
+#if (USYS_CRON_QUEUE_SIZE & (USYS_CRON_QUEUE_SIZE - 1))
+#error "USYS_CRON_QUEUE_SIZE must be a power of 2"
+#endif
+#if (USYS_CRON_BUDGET || USYS_PROFILE_JITTER) && !USYS_PROFILE
+#error "USYS_CRON_BUDGET and USYS_PROFILE_JITTER need USYS_PROFILE"
+#endif
+#define  _QUEUE_MASK    (USYS_CRON_QUEUE_SIZE - 1)
+
 /*!
- *  Cron Table holds all requested entries for periodic function calls.
- *  \note
- *    All the entries will run in privileged mode and will use the main
- *    stack.
+ *  Scheduler context of a core. Each core's SysTick_Callback() works on its
+ *  own context and service_add()/service_rem(), the timers and
+ *  usys_run_pending() on the context of the calling core. So the cores
+ *  schedule their services with no shared state.
+ */
+typedef struct {
+   /*!
+    *  Cron Table holds all requested entries for periodic function calls.
+    *  \note
+    *    All the entries will run in privileged mode and will use the main
+    *    stack.
+    */
+#if USYS_CRONTAB_ENTRIES
+   crontab_t      crontab[USYS_CRONTAB_ENTRIES];
+   usys_service_t srv[USYS_CRONTAB_ENTRIES];    //!< The descriptors of the crontab[] entries
+#else
+   crontab_t      crontab[1];       // Static services only. Keeps the code valid
+   usys_service_t srv[1];
+#endif
+
+   /*!
+    *  Cron timer wheel. Each active entry is linked in the bucket of its
+    *  next deadline (exp & _WHEEL_MASK). On each tick only the bucket of the
+    *  current scheduler time is visited.
+    *  \note
+    *    The wheel lists are touched only from SysTick_Callback(). Thread
+    *    context (service_add/service_rem) only changes the state of a
+    *    crontab[] entry and raises \a dirty. The state is the publish
+    *    point, see cron_state_en, so no interrupt masking is needed.
+    */
+   crontab_t           *wheel[USYS_CRON_WHEEL_SLOTS];
+   clock_t              wheel_tick;    //!< Scheduler time. Never rewinds
+   volatile uint8_t     dirty;         //!< Pending changes
+
+   /*!
+    *  Deferred services ready queue. Single producer (SysTick_Callback) and
+    *  single consumer (usys_run_pending), so no locking is needed. Each
+    *  index is written only by its own side and both run free.
+    */
+   crontab_t * volatile queue[USYS_CRON_QUEUE_SIZE];
+   volatile unsigned int queue_head;   //!< Written by the ISR only
+   volatile unsigned int queue_tail;   //!< Written by usys_run_pending() only
+
+#if USYS_TIMERS
+   /*!
+    *  Software timers in a binary min-heap, ordered by deadline and then by
+    *  priority. Each tick checks only the head. Arm and cancel are O(log n)
+    *  and run with the interrupts masked, as timers can be armed from any
+    *  context of the core.
+    */
+   usys_timer_t        *theap[USYS_TIMERS];
+   volatile uint32_t    theap_n;       //!< Armed timers
+#endif
+
+#if USYS_PROFILE
+   /*!
+    *  Profiling data. The ISR increments \a prof_seq on entry and exit, so
+    *  a snapshot from thread context retries if it gets interrupted.
+    */
+   usys_isr_stat_t      prof_isr;
+   uint32_t             prof_last;     //!< Cycles at the previous ISR entry
+   volatile uint32_t    prof_seq;
+#endif
+}_cpu_t;
+
+/*!
+ *  The per core contexts. The primary core (0) also owns the time base and
+ *  the static services, so its wheel starts dirty to link them.
+ */
+static _cpu_t  _cpus[USYS_CPUS] = { { .dirty = 1 } };
+
+#define  _PRIMARY       (&_cpus[0])
+#if USYS_CPUS > 1
+#define  _CPU           (&_cpus[usys_cpu_id ()])
+#else
+#define  _CPU           (&_cpus[0])
+#endif
+
+/*!
+ *  Static services, registered with USYS_SERVICE(). The linker collects
+ *  their entry pointers in the usys_services section. The symbols are weak,
+ *  so with no static services both are NULL. They run on the primary core.
+ */
+extern crontab_t * const __start_usys_services[] __attribute__ ((weak));
+extern crontab_t * const __stop_usys_services[] __attribute__ ((weak));
+
+#define  _CRON_STATIC      ((int)(__stop_usys_services - __start_usys_services))
+#define  _CRON_ALL(_c_)    (USYS_CRONTAB_ENTRIES + (((_c_) == _PRIMARY) ? _CRON_STATIC : 0))
+//! All the cron entries of a core, crontab[] first and the static services next
+#define  _cron_entry(_c_, _i_)   (((_i_) < USYS_CRONTAB_ENTRIES) ? \
+                              &(_c_)->crontab[_i_] : __start_usys_services[(_i_) - USYS_CRONTAB_ENTRIES])
+
+/*!
+ * \brief
+ *    Push an entry in the wheel bucket of its deadline
+ */
+static void _cron_link (_cpu_t *c, crontab_t *e) {
+   crontab_t **b = &c->wheel[e->exp & _WHEEL_MASK];
+   e->next = *b;
+   *b = e;
+}
+
+/*!
+ * \brief
+ *    Remove an entry from the wheel bucket of its deadline
+ */
+static void _cron_unlink (_cpu_t *c, crontab_t *e) {
+   crontab_t **pp = &c->wheel[e->exp & _WHEEL_MASK];
+   while (*pp && *pp != e)
+      pp = &(*pp)->next;
+   if (*pp)
+      *pp = e->next;
+}
+
+// Scheduler trace, a record per service call
+#if USYS_TRACE && USYS_TRACE_SCHED
+#define  _trace_service(_e_)  usys_trace (USYS_TRACE_ID_SERVICE, (uintptr_t)(_e_)->srv->fun)
+#else
+#define  _trace_service(_e_)  ((void)0)
+#endif
+
+#if USYS_PROFILE
+/*!
+ * \brief
+ *    Account \a c cycles to \a s
+ */
+static void _stat_add (usys_stat_t *s, uint32_t c) {
+   if (!s->calls || c < s->min)
+      s->min = c;
+   if (c > s->max)
+      s->max = c;
+   s->sum += c;
+   ++s->calls;
+}
+
+#if USYS_PROFILE_JITTER
+/*!
+ * \brief
+ *    Account the start time error of a service starting at \a c0 cycles.
+ *    The period in cycles wraps with the counter, so the error is exact
+ *    while it fits in 31 bits.
+ */
+static void _jitter_add (crontab_t *e, uint32_t c0) {
+   usys_jitter_t *j = &e->jit;
+   uint32_t p = USYS_PROFILE_TICK_CYCLES ();
+   uint32_t a, k;
+   int32_t d;
+
+   if (p && e->stat.calls) {
+      d = (int32_t)(c0 - e->start - (uint32_t)e->srv->tic * p);
+      a = (d < 0) ? -(uint32_t)d : (uint32_t)d;
+      k = (a) ? 32 - usys_clz (a) : 0;
+      ++j->hist[(k < USYS_JITTER_BINS) ? k : USYS_JITTER_BINS - 1];
+      if (!j->calls || d < j->min)
+         j->min = d;
+      if (!j->calls || d > j->max)
+         j->max = d;
+      j->sum += a;
+      ++j->calls;
+   }
+   e->start = c0;
+}
+#else
+#define  _jitter_add(_e_, _c_)
+#endif
+
+/*!
+ * \brief
+ *    Call a service and account its runtime
+ */
+static void _cron_call (crontab_t *e) {
+   uint32_t c;
+
+   _trace_service (e);
+   c = USYS_PROFILE_CYCLES ();
+   _jitter_add (e, c);
+   e->srv->fun ();
+   c = USYS_PROFILE_CYCLES () - c;
+   _stat_add (&e->stat, c);
+#if USYS_CRON_BUDGET
+   if (e->wcet && c > e->wcet) {
+      ++e->stat.over;
+      if (!(e->flags & USYS_SRV_DEFERRED))   // Out of the ISR from the next run
+         e->flags |= USYS_SRV_DEFERRED | USYS_SRV_DEMOTED;
+   }
+#endif
+}
+
+/*!
+ * \brief
+ *    ISR entry accounting. Counts the ticks lost since the previous entry.
+ */
+static void _prof_enter (_cpu_t *c, uint32_t c0) {
+   uint32_t p = USYS_PROFILE_TICK_CYCLES ();
+   uint32_t d = c0 - c->prof_last;
+
+   ++c->prof_seq;
+   if (p && c->prof_isr.isr.calls && d > p + (p >> 1))
+      c->prof_isr.missed += (d + (p >> 1)) / p - 1;
+   c->prof_last = c0;
+}
+
+/*!
+ * \brief
+ *    ISR exit accounting
+ */
+static void _prof_exit (_cpu_t *c, uint32_t c0) {
+   _stat_add (&c->prof_isr.isr, USYS_PROFILE_CYCLES () - c0);
+   ++c->prof_seq;
+}
+#else
+#define  _cron_call(_e_)      (_trace_service (_e_), (_e_)->srv->fun ())
+#endif
+
+/*!
+ * \brief
+ *    Push a deferred entry to the ready queue. An entry already waiting
+ *    is not queued again.
+ */
+static void _cron_defer (_cpu_t *c, crontab_t *e)
+{
+   unsigned int h = c->queue_head;
+
+   if (e->pend || h - c->queue_tail >= USYS_CRON_QUEUE_SIZE)
+      return;     // Already queued, or full (retry on the next period)
+   e->pend = 1;
+   c->queue[h & _QUEUE_MASK] = e;
+   c->queue_head = h + 1;    // Publish after the slot is written
+}
+
+/*!
+ * \brief
+ *    Pick a phase for a \ref USYS_SRV_STAGGER entry. Among the first
+ *    min(tic, USYS_CRON_WHEEL_SLOTS) ticks of its period it selects the
+ *    one whose wheel bucket holds the fewer entries.
+ * \param   tic   The entry's period
+ * \return        The phase in ticks
+ */
+static clock_t _cron_stagger (_cpu_t *c, clock_t tic)
+{
+   crontab_t *e;
+   clock_t o, best = 0;
+   unsigned int n, min = UINT_MAX;
+
+   for (o=0 ; o<tic && o<USYS_CRON_WHEEL_SLOTS ; ++o) {
+      n = 0;
+      for (e = c->wheel[(c->wheel_tick + tic + o) & _WHEEL_MASK] ; e ; e = e->next)
+         ++n;
+      if (n < min) {
+         min = n;
+         best = o;
+         if (!n)  break;
+      }
+   }
+   return best;
+}
+
+/*!
+ * \brief
+ *    Run a due entry, inline or through the deferred queue
  */
-static crontab_t  _crontab[USYS_CRONTAB_ENTRIES];
+static void _cron_run (_cpu_t *c, crontab_t *e) {
+   if (e->flags & USYS_SRV_DEFERRED)
+      _cron_defer (c, e);
+   else
+      _cron_call (e);
+}
+
+/*!
+ * \brief
+ *    Apply the pending service_add()/service_rem() requests to the wheel.
+ *    This runs only when _crontab[] has changed, and on the first tick to
+ *    link the static services.
+ */
+static void _cron_update (_cpu_t *c)
+{
+   crontab_t *e;
+   int i;
+
+   c->dirty = 0;  // Clear first, so a request during the scan is not lost
+   usys_barrier ();
+   for (i=0 ; i<_CRON_ALL (c) ; ++i) {
+      e = _cron_entry (c, i);
+      switch (e->state) {
+         case CRON_ADD:
+            usys_barrier ();  // Acquire: read the fields after the state
+            if (e->flags & USYS_SRV_STAGGER)
+               e->exp += _cron_stagger (c, e->srv->tic);
+            e->exp += c->wheel_tick;  // Relative to absolute deadline
+#if USYS_PROFILE
+            memset (&e->stat, 0, sizeof (usys_stat_t));
+#endif
+#if USYS_PROFILE_JITTER
+            memset (&e->jit, 0, sizeof (usys_jitter_t));
+#endif
+            if (usys_cas (&e->state, CRON_ADD, CRON_ACTIVE)) {
+               _cron_link (c, e);
+               break;
+            }
+            // service_rem() came first, the entry is not linked
+            usys_barrier ();
+            e->state = CRON_FREE;
+            break;
+         case CRON_REM:
+            _cron_unlink (c, e);
+            usys_barrier ();  // Release: the slot is unlinked before it is free
+            e->state = CRON_FREE;
+            break;
+         default:
+            break;
+      }
+   }
+}
+
+/*!
+ * \brief
+ *    Run one scheduler tick. Visits only the bucket of the current
+ *    scheduler time and calls the entries that are due.
+ */
+static void _cron_tick (_cpu_t *c)
+{
+   crontab_t **pp, *e;
+
+   if (c->dirty)
+      _cron_update (c);
+
+   pp = &c->wheel[++c->wheel_tick & _WHEEL_MASK];
+   while ((e = *pp)) {
+      if (e->exp != c->wheel_tick) {
+         pp = &e->next;    // Due on a later round of the wheel
+         continue;
+      }
+      // Re-arm to the next deadline before the call
+      *pp = e->next;
+      e->exp += e->srv->tic;
+      _cron_link (c, e);
+      if (e->state == CRON_ACTIVE)
+         _cron_run (c, e);
+   }
+}
 
+/*!
+ * \brief
+ *    Move the scheduler \a n ticks forward in one step and run the entries
+ *    that became due, according to their catch-up policy. Visits the
+ *    buckets of the \a n passed ticks, or all of them once for a longer
+ *    step.
+ */
+static void _cron_catchup (_cpu_t *c, clock_t n)
+{
+   crontab_t **pp, *e;
+   clock_t b, nb, late, k, tic;
+
+   c->wheel_tick += n;
+   if (c->dirty)
+      _cron_update (c);  // New entries count from now
+
+   nb = (n < USYS_CRON_WHEEL_SLOTS) ? n : USYS_CRON_WHEEL_SLOTS;
+   for (b=0 ; b<nb ; ++b) {
+      pp = &c->wheel[(c->wheel_tick - b) & _WHEEL_MASK];
+      while ((e = *pp)) {
+         if ((sclock_t)(late = c->wheel_tick - e->exp) < 0) {
+            pp = &e->next;    // Not due yet
+            continue;
+         }
+         // Missed periods, with no division for the usual case
+         tic = e->srv->tic;
+         k = (late < tic) ? 1 : late / tic + 1;
+         *pp = e->next;
+         e->exp += k * tic;      // Next deadline after now, on the same phase
+         _cron_link (c, e);
+         if (e->state != CRON_ACTIVE)
+            continue;
+         if (!(e->flags & USYS_SRV_CATCHUP))
+            k = 1;
+         while (k--)
+            _cron_run (c, e);
+      }
+   }
+}
+
+#if USYS_TIMERS
+/*!
+ * \brief
+ *    Heap order: the earlier deadline first, the higher priority first
+ *    on the same deadline.
+ */
+static int _tless (const usys_timer_t *a, const usys_timer_t *b) {
+   smclock_t d = (smclock_t)(a->exp - b->exp);
+   return d < 0 || (!d && a->prio > b->prio);
+}
+
+static void _theap_set (_cpu_t *c, uint32_t i, usys_timer_t *t) {
+   c->theap[i] = t;
+   t->idx = (uint16_t)(i + 1);
+}
+
+static void _theap_up (_cpu_t *c, uint32_t i) {
+   usys_timer_t *t = c->theap[i];
+   while (i && _tless (t, c->theap[(i - 1) >> 1])) {
+      _theap_set (c, i, c->theap[(i - 1) >> 1]);
+      i = (i - 1) >> 1;
+   }
+   _theap_set (c, i, t);
+}
+
+static void _theap_down (_cpu_t *c, uint32_t i) {
+   usys_timer_t *t = c->theap[i];
+   uint32_t k;
+   while ((k = 2*i + 1) < c->theap_n) {
+      if (k + 1 < c->theap_n && _tless (c->theap[k + 1], c->theap[k]))
+         ++k;
+      if (!_tless (c->theap[k], t))
+         break;
+      _theap_set (c, i, c->theap[k]);
+      i = k;
+   }
+   _theap_set (c, i, t);
+}
+
+/*!
+ * \brief
+ *    Remove an armed timer from the heap. Interrupts must be masked.
+ */
+static void _theap_del (_cpu_t *c, usys_timer_t *t) {
+   uint32_t i = t->idx - 1;
+   usys_timer_t *last = c->theap[--c->theap_n];
+
+   t->idx = 0;
+   if (i < c->theap_n) {
+      _theap_set (c, i, last);
+      _theap_up (c, i);
+      _theap_down (c, last->idx - 1);
+   }
+}
+
+/*!
+ * \brief
+ *    Insert a timer in the heap. Interrupts must be masked.
+ */
+static void _theap_push (_cpu_t *c, usys_timer_t *t) {
+   c->theap[c->theap_n] = t;
+   _theap_up (c, c->theap_n++);
+}
+
+/*!
+ * \brief
+ *    Run the software timers that are due. Checks only the heap head.
+ */
+static void _timer_tick (_cpu_t *c)
+{
+   usys_timer_t *t;
+   mclock_t now;
+   uint32_t s;
+
+   if (!c->theap_n)
+      return;
+   now = mclock ();
+   for (;;) {
+      s = usys_irq_save ();
+      if (!c->theap_n || (smclock_t)(c->theap[0]->exp - now) > 0) {
+         usys_irq_restore (s);
+         return;
+      }
+      t = c->theap[0];
+      _theap_del (c, t);
+      if (t->period) {
+         t->exp += t->period;    // Drift free reload
+         if ((smclock_t)(t->exp - now) <= 0)
+            // Late (after a SysTick_Advance()), skip the missed periods
+            t->exp += ((mclock_t)(now - t->exp) / t->period + 1) * t->period;
+         _theap_push (c, t);
+      }
+      usys_irq_restore (s);
+      t->fun (t->arg);
+   }
+}
+
+/*!
+ * \brief
+ *    Find the distance of the nearest software timer deadline.
+ * \return  The ticks until the heap head is due, or 0 if no timer is armed
+ */
+static clock_t _timer_next (_cpu_t *c)
+{
+   smclock_t d = 0;
+   uint32_t s = usys_irq_save ();
+
+   if (c->theap_n && (d = (smclock_t)(c->theap[0]->exp - mclock ())) < 1)
+      d = 1;
+   usys_irq_restore (s);
+   return (clock_t)d;
+}
+#else
+#define  _timer_tick(_c_)
+#define  _timer_next(_c_)     (0)
+#endif
+
+/*!
+ * \brief
+ *    Find the distance of the nearest cron deadline. Safe from thread
+ *    context, it only reads the wheel.
+ * \return  The ticks until the next due entry, 1 if there are changes to
+ *          link, or 0 if cron is empty
+ */
+static clock_t _cron_next (_cpu_t *c)
+{
+   crontab_t *e;
+   clock_t i, dt, min = 0, lag = 0;
+
+   if (c->dirty)
+      return 1;   // The tick links the changes, only it touches the wheel
+#if _USYS_TICK_FAST
+   lag = __mticks - c->wheel_tick;  // The fast path moves the wheel on the events only
+#endif
+
+   for (i=1 ; i<=USYS_CRON_WHEEL_SLOTS ; ++i) {
+      for (e = c->wheel[(c->wheel_tick + i) & _WHEEL_MASK] ; e ; e = e->next) {
+         if ((dt = e->exp - c->wheel_tick) == i) {
+            min = i;    // Due on this round of the wheel, nothing sooner
+            i = USYS_CRON_WHEEL_SLOTS;
+            break;
+         }
+         if (!min || dt < min)
+            min = dt;
+      }
+   }
+   return (!min) ? 0 : (min > lag) ? min - lag : 1;
+}
+
+/*!
+ * \brief
+ *    Length of the next second in ticks. With \ref USYS_TIME_TRIM the
+ *    trim adds to a fixed point fraction and its whole ticks go to this
+ *    second, so there is no division in the ISR.
+ */
+static clock_t _sec_reload (void)
+{
+#if USYS_TIME_TRIM
+   int32_t n;
+
+   _trim_acc += _trim_q16;
+   n = _trim_acc >> 16;    // Whole ticks, rounded down
+   _trim_acc &= 0xFFFF;    // Keep the fraction
+   return _sec_len = _freq + n;
+#else
+   return _freq;
+#endif
+}
+
+/*!
+ * \brief
+ *    Second boundary of the time base. Runs when \sa _sec_cnt expires
+ *    and reloads it, so the tick path only decrements and compares.
+ */
+static void _time_second (void)
+{
+   if (_freq) {
+#if USYS_RTC_RESYNC
+      ++__now;    // Also counts the cached RTC time between the resyncs
+      if (_ext_time && !_rtc_cnt--) {
+         _rtc_cnt = USYS_RTC_RESYNC - 1;
+         _rtc_sync = 1;    // The next time() reads the RTC, out of the ISR
+      }
+#else
+      if (!_ext_time)
+         ++__now; // Do not update __now when we have external time system
+#endif
+      _sec_cnt = _sec_reload ();
+   }
+   else if ((_freq = get_freq ())) {
+      _sec_cnt = (_freq > 1) ? _freq - 1 : 1;   // First tick already counted
+#if USYS_TIME_TRIM
+      _sec_len = _freq;
+#endif
+   }
+   else
+      _sec_cnt = 1;        // HAL not ready yet, retry on the next tick
+}
+
+/*!
+ * \brief
+ *    Find the distance of the nearest cron or software timer deadline.
+ * \return  The ticks until the next event, or 0 if there is none
+ */
+static clock_t _next_event (_cpu_t *c)
+{
+   clock_t d = _cron_next (c);
+   clock_t t = _timer_next (c);
+   return (!d || (t && t < d)) ? t : d;
+}
+
+#if _USYS_TICK_FAST
+#define  _DUE_NONE      ((clock_t)1 << (sizeof (clock_t) * CHAR_BIT - 2))
+static uint8_t _kick;                  //!< The due tick was moved since the last _tick_due()
+
+/*!
+ * \brief
+ *    Program the tick of the next event for the usys_systick() fast path.
+ *    A _tick_kick() from a nested ISR during the computation wins.
+ */
+static void _tick_due (_cpu_t *c)
+{
+   clock_t d = (c->dirty) ? 1 : _next_event (c);
+   uint32_t s = usys_irq_save ();
+
+   __usys_tbase.due = __mticks + ((_kick) ? 0 : (d) ? d : _DUE_NONE);
+   _kick = 0;
+   usys_irq_restore (s);
+}
+
+/*!
+ * \brief
+ *    Make the next tick take the slow path, after a change of the services
+ *    or the timers
+ */
+static void _tick_kick (void)
+{
+   uint32_t s = usys_irq_save ();
+
+   _kick = 1;
+   __usys_tbase.due = __mticks;
+   usys_irq_restore (s);
+}
+#else
+#define  _tick_due(_c_)       ((void)0)
+#define  _tick_kick()         ((void)0)
+#endif
+
+/*!
+ * \brief
+ *    Move the time variables forward by \a n ticks in one step
+ */
+static void _time_advance (clock_t n)
+{
+   _mticks_add (n);
+   while (n >= _sec_cnt) {
+      n -= _sec_cnt;
+      _time_second ();
+   }
+   _sec_cnt -= n;
+}
 
 /*!
  * \brief
@@ -60,23 +763,109 @@ static crontab_t  _crontab[USYS_CRONTAB_ENTRIES];
  * to provide micro system - os like functionalities to an application
  * without RTOS
  * \note
- *    The User HAS TO CALL this from the application's SysTick_IRQ
+ *    The User HAS TO CALL this from the application's SysTick_IRQ. With
+ *    \ref USYS_CPUS each core calls it from its own SysTick_IRQ. Only the
+ *    primary core moves the time base, the others run their services.
  */
 void SysTick_Callback (void)
 {
-   int i;
-
+#if _USYS_TICK_FAST
+   usys_systick ();
+#else
+   _cpu_t *c = _CPU;
+#if USYS_PROFILE
+   uint32_t c0;
+#endif
    // Time
-   ++__ticks;
-   ++__sticks;
-   if ( !_ext_time && !(__ticks % get_freq ()) )
-      ++__now; // Do not update __now when we have external time system
+   if (c == _PRIMARY)
+      _mticks_add (1);
+#if USYS_PROFILE
+   // After the tick count, as the down-counter has already reloaded and
+   // the usys_cycles() default would be a tick ahead before it
+   c0 = USYS_PROFILE_CYCLES ();
+   _prof_enter (c, c0);
+#endif
+   if (c == _PRIMARY && !--_sec_cnt)
+      _time_second ();
 
    // Cron
-   for (i=0 ; i<USYS_CRONTAB_ENTRIES ; ++i) {
-      if (_crontab[i].fun && !(__ticks %_crontab[i].tic))
-         _crontab[i].fun ();
+   _cron_tick (c);
+   _timer_tick (c);
+#if USYS_PROFILE
+   _prof_exit (c, c0);
+#endif
+#endif
+}
+
+#if _USYS_TICK_FAST
+/*!
+ * \brief
+ *    The tick slow path, called by usys_systick() when the second ends or
+ *    the next event is due. No entry was due on the ticks since the
+ *    previous call, so the wheel moves over them without a visit.
+ */
+void usys_systick_event (void)
+{
+   _cpu_t *c = _PRIMARY;
+   clock_t n;
+
+   if (!_sec_cnt)
+      _time_second ();
+   if ((n = __mticks - c->wheel_tick) > 1)
+      c->wheel_tick += n - 1;
+   _cron_tick (c);
+   _timer_tick (c);
+   _tick_due (c);
+}
+#endif
+
+/*!
+ * \brief
+ *    Move the time base forward by \a n ticks in one call.
+ *
+ * This is the tickless (or late) counterpart of SysTick_Callback(). The HAL
+ * calls it with the ticks elapsed since the previous call, for ex: after a
+ * tickless sleep, or when SysTick was delayed by a higher priority ISR or a
+ * debugger halt. All the time variables move in one step. Each overdue
+ * service runs once, or once per missed period with \ref USYS_SRV_CATCHUP,
+ * and keeps its phase. Overdue periodic software timers run once.
+ * \note
+ *    With \ref USYS_TICKLESS the next deadline is programmed to the HAL
+ *    via set_compare() before returning.
+ *
+ * \param   n     Number of elapsed ticks since the previous call
+ */
+void SysTick_Advance (clock_t n)
+{
+   _cpu_t *c = _CPU;
+
+   if (n) {
+      if (c == _PRIMARY)
+         _time_advance (n);
+#if _USYS_TICK_FAST
+      n = __mticks - c->wheel_tick;    // With the ticks the wheel skipped since the last event
+#endif
+      _cron_catchup (c, n);
+      _timer_tick (c);
+      _tick_due (c);
    }
+#if USYS_TICKLESS
+   set_compare (usys_next_deadline ());
+#endif
+}
+
+/*!
+ * \brief
+ *    Calculates the ticks until the next cron or software timer deadline.
+ *    A tickless HAL can use it to decide how long to sleep.
+ * \return
+ *    The ticks to the next due entry of the calling core, bounded to
+ *    \ref USYS_TICKLESS_MAX
+ */
+clock_t usys_next_deadline (void)
+{
+   clock_t d = _next_event (_CPU);
+   return (!d || d > USYS_TICKLESS_MAX) ? USYS_TICKLESS_MAX : d;
 }
 /*
  * ========= Set Functions ============
@@ -92,7 +881,12 @@ void SysTick_Callback (void)
  * \return        None
  */
 void usys_set_rtc_time (ext_time_ft f) {
-   if (f)   _ext_time = f;
+   if (f) {
+      _ext_time = f;
+#if USYS_RTC_RESYNC
+      _rtc_sync = 1;
+#endif
+   }
 }
 
 /*!
@@ -107,6 +901,110 @@ void usys_set_rtc_settime (ext_settime_ft f) {
    if (f)   _ext_settime = f;
 }
 
+/*!
+ * \brief
+ *    Re-reads the time base frequency from the HAL. The time base caches
+ *    get_freq(), so the HAL (or the User) has to call this every time the
+ *    frequency changes outside of usys_set_freq().
+ * \note
+ *    The count of the current second restarts.
+ */
+void usys_freq_changed (void) {
+   clock_t f = get_freq ();
+   _sec_cnt = (f) ? f : 1;
+#if USYS_TIME_TRIM
+   _sec_len = _sec_cnt;
+#if USYS_TIME_TRIM_LEARN
+   _learn.valid = 0;       // The ticks of the previous settime() are not comparable
+#endif
+#endif
+   _freq = f;
+#if USYS_TIME_TRIM
+   usys_set_trim (_trim);
+#endif
+}
+
+/*!
+ * \brief
+ *    Sets the time base frequency through the HAL's set_freq() and updates
+ *    the cached value.
+ * \param   sf    The new frequency in Hz
+ * \return        The set_freq() result
+ */
+int usys_set_freq (clock_t sf) {
+   int r = set_freq (sf);
+   usys_freq_changed ();
+   return r;
+}
+
+/*!
+ * \brief
+ *    Gets the time base frequency without a call to the HAL.
+ * \return        The time base frequency in Hz
+ */
+clock_t usys_get_freq (void) {
+   return (_freq) ? _freq : get_freq ();
+}
+
+#if USYS_TIME_TRIM
+/*!
+ * \brief
+ *    Sets the calendar clock trim. Each second of time() lasts
+ *    get_freq() * (1 + ppm / 1e6) ticks. The cron services and the clocks
+ *    in ticks are not affected.
+ * \note
+ *    The ppm of usys_drift() is the trim to set.
+ *
+ * \param   ppm   The trim in ppm. Positive for a fast time base.
+ *                Clamped to +/- 20000.
+ */
+void usys_set_trim (int32_t ppm) {
+   if (ppm > _TRIM_MAX)    ppm = _TRIM_MAX;
+   if (ppm < -_TRIM_MAX)   ppm = -_TRIM_MAX;
+   _trim = ppm;
+   _trim_q16 = (int32_t)(((int64_t)usys_get_freq () * ppm * 65536) / 1000000);
+}
+
+/*!
+ * \brief
+ *    Gets the calendar clock trim
+ * \return        The trim in ppm
+ */
+int32_t usys_get_trim (void) {
+   return _trim;
+}
+
+#if USYS_TIME_TRIM_LEARN
+/*!
+ * \brief
+ *    Learn the trim from a settime() correction. The ticks between two
+ *    settime() calls over the seconds between the times they set give the
+ *    actual ticks per second. Corrections that come too soon are skipped
+ *    and measured against the older one.
+ *
+ * \param   t     The time settime() sets
+ */
+static void _trim_learn (time_t t)
+{
+   mclock_t m = mclock ();
+   int64_t s, n;
+
+   if (_learn.valid) {
+      s = (int64_t)(t - _learn.t);
+      if (s > 0 && s < USYS_TIME_TRIM_LEARN)
+         return;
+      if (s > 0) {
+         n = s * usys_get_freq ();
+         usys_set_trim ((int32_t)(((int64_t)(m - _learn.m) - n) * 1000000 / n));
+      }
+   }
+   _learn.valid = 1;
+   _learn.t = t;
+   _learn.m = m;
+}
+#endif
+#endif   // #if USYS_TIME_TRIM
+
 /*
  * ======== OS like Functionalities ============
  */
@@ -121,7 +1019,7 @@ void usys_set_rtc_settime (ext_settime_ft f) {
  *    CLK_TCK or CLOCKS_PER_SEC
  */
 inline clock_t clock (void) {
-   return (clock_t) __ticks;
+   return (clock_t)(__mticks + __usys_tbase.ticks_ofs);
 }
 
 /*!
@@ -136,7 +1034,8 @@ inline clock_t clock (void) {
  *    CLK_TCK or CLOCKS_PER_SEC
  */
 inline clock_t setclock (clock_t c) {
-   return __ticks = c;
+   __usys_tbase.ticks_ofs = c - __mticks;
+   return c;
 }
 
 /*!
@@ -149,7 +1048,7 @@ inline clock_t setclock (clock_t c) {
  *    CLK_TCK or CLOCKS_PER_SEC
  */
 inline sclock_t sclock (void) {
-   return (sclock_t) __sticks;
+   return (sclock_t)(__mticks + __usys_tbase.sticks_ofs);
 }
 
 /*!
@@ -164,7 +1063,61 @@ inline sclock_t sclock (void) {
  *    CLK_TCK or CLOCKS_PER_SEC
  */
 inline sclock_t setsclock (sclock_t c) {
-   return __sticks = c;
+   __usys_tbase.sticks_ofs = (clock_t)c - __mticks;
+   return c;
+}
+
+/*!
+ * \brief
+ *    determines the monotonic processor time. This time can not be set.
+ * \note
+ *    With \ref USYS_CLOCK64 on a 32-bit target, the high half is read
+ *    before and after the low half until it is stable, so the value is
+ *    never torn by the SysTick ISR and no interrupt masking is needed.
+ *    With \ref USYS_CPUS a sequence count does the same against the
+ *    primary core.
+ * \return
+ *    The ticks since the start of the time base.
+ */
+mclock_t mclock (void)
+{
+#if defined (_MTICKS_HI) && (USYS_CPUS > 1)
+   clock_t h, l;
+   uint32_t q;
+   do {
+      q = __mticks_seq;
+      usys_barrier ();
+      h = __mticks_hi;
+      l = __mticks;
+      usys_barrier ();
+   } while ((q & 1) || q != __mticks_seq);
+   return ((mclock_t)h << 32) | l;
+#elif defined (_MTICKS_HI)
+   clock_t h, l;
+   do {
+      h = __mticks_hi;
+      l = __mticks;
+   } while (h != __mticks_hi);
+   return ((mclock_t)h << 32) | l;
+#else
+   return (mclock_t)__mticks;
+#endif
+}
+
+/*!
+ * \brief
+ *    Store a new \sa __now, atomically with respect to the SysTick ISR.
+ *    (time_t) -1 from a failed RTC read keeps the current value.
+ */
+static void _now_set (time_t t)
+{
+   uint32_t s;
+
+   if (t == (time_t)-1)
+      return;
+   s = usys_irq_save ();
+   __now = t;
+   usys_irq_restore (s);
 }
 
 /*!
@@ -178,14 +1131,141 @@ inline sclock_t setsclock (sclock_t c) {
  */
 time_t time (time_t *timer)
 {
+#if USYS_RTC_RESYNC
+   if (_ext_time && _rtc_sync) {
+      _rtc_sync = 0;
+      _now_set (_ext_time (NULL));  // Resync the cache to the RTC
+   }
+#else
    if (_ext_time)
       return _ext_time (timer);     // Forward to external time system
-   else {                           // If no external system, use __now
-      if (timer)  *timer = (time_t)__now;
-      return (time_t)__now;
+#endif
+   if (timer)  *timer = (time_t)__now;
+   return (time_t)__now;
+}
+
+/*!
+ * \brief
+ *    Determines the calendar time with sub-second resolution. The seconds
+ *    are the same as time(), the microseconds come from the ticks of the
+ *    current second and with \ref USYS_HIRES_CLOCK from the hardware
+ *    down-counter too. No RTC access is needed between the resyncs.
+ * \param   tv    Pointer to receive the time
+ * \param   tz    Obsolete timezone, ignored
+ * \return        On success, zero is returned. On error, -1 is returned
+ */
+int usys_gettimeofday (struct timeval *tv, void *tz)
+{
+   time_t t, s;
+   clock_t c, f;
+   uint64_t us;
+#if USYS_HIRES_CLOCK
+   uint32_t v, load;
+   int p;
+#endif
+
+   (void)tz;
+   if (!tv)
+      return -1;
+   t = time (NULL);     // Resync if needed
+   f = usys_get_freq ();
+   do {
+      s = __now;
+      c = _sec_cnt;
+#if USYS_TIME_TRIM
+      f = _sec_len;        // The trimmed length of this second
+#endif
+#if USYS_HIRES_CLOCK
+      v = get_count ();
+      if ((p = get_pending ()))
+         v = get_count ();    // A tick not counted yet, see _hires_read()
+#endif
+   } while (s != __now || c != _sec_cnt);
+
+   if (f && c <= f) {
+      us = (uint64_t)(f - c) * 1000000UL;    // Ticks elapsed in this second
+#if USYS_HIRES_CLOCK
+      us += (uint64_t)p * 1000000UL;
+      load = get_reload ();
+      us += (uint64_t)(load - v) * 1000000UL / ((uint64_t)load + 1);
+#endif
+      us /= f;
    }
+   else
+      us = 0;
+   // Without the RTC cache the seconds come from the provider, not aligned
+   // to the tick base
+   tv->tv_sec = (!USYS_RTC_RESYNC && _ext_time) ? t : s;
+   tv->tv_usec = (us < 1000000UL) ? (suseconds_t)us : 999999;
+   return 0;
+}
+
+
+#if USYS_HIRES_CLOCK
+/*!
+ * \brief
+ *    Reads the monotonic tick count together with the elapsed part of
+ *    the current tick from the hardware down-counter.
+ *    The tick count is re-read until it is stable, so a SysTick
+ *    interrupt in between can not tear the pair. A reload whose interrupt
+ *    did not run yet (interrupts masked, a higher priority ISR) counts as
+ *    one more tick, with the counter read again after the reload.
+ */
+static mclock_t _hires_read (uint32_t *sub, uint32_t *load)
+{
+   mclock_t t;
+   uint32_t v;
+   int p;
+
+   do {
+      t = mclock ();
+      v = get_count ();
+      if ((p = get_pending ()))
+         v = get_count ();    // Surely after the reload
+   } while ((clock_t)t != __mticks);
+   t += (p) ? 1 : 0;
+   *load = get_reload ();
+   *sub = *load - v;    // Down-counter: elapsed cycles in the current tick
+   return t;
+}
+
+/*!
+ * \brief
+ *    Determines the monotonic CPU time in time base counter cycles
+ *    (the CPU cycles for SysTick running from the core clock).
+ * \return
+ *    The 64-bit cycle count since the start of the time base.
+ */
+uint64_t usys_cycles (void)
+{
+   uint32_t sub, load;
+   mclock_t t = _hires_read (&sub, &load);
+   return (uint64_t)t * ((uint64_t)load + 1) + sub;
 }
 
+/*!
+ * \brief
+ *    Determines the monotonic CPU time in nanoseconds.
+ * \note
+ *    This needs a few 64-bit divisions. For cheap profiling timestamps
+ *    prefer usys_cycles().
+ * \return
+ *    The 64-bit nanoseconds since the start of the time base.
+ */
+uint64_t usys_clock_ns (void)
+{
+   uint32_t sub, load;
+   mclock_t t = _hires_read (&sub, &load);
+   clock_t f = usys_get_freq ();
+   uint64_t frac;
+
+   if (!f)
+      return 0;
+   frac = (uint64_t)(t % f) * 1000000000ULL
+        + (uint64_t)sub * 1000000000ULL / ((uint64_t)load + 1);
+   return (uint64_t)(t / f) * 1000000000ULL + frac / f;
+}
+#endif   // #if USYS_HIRES_CLOCK
 
 /*!
  * \brief
@@ -199,16 +1279,23 @@ time_t time (time_t *timer)
  */
 int settime (const time_t *t)
 {
-   if (_ext_settime)
-      return _ext_settime (t);      // Forward to external time system
-   else {                           // If no external system, use __now
-      if (t) {
-         __now = *t;
-         return 0;
-      }
-      else
+   if (_ext_settime) {
+      if (_ext_settime (t))         // Forward to external time system
          return -1;
+#if !USYS_RTC_RESYNC
+      return 0;
+#endif
+   }
+   if (t) {                         // Update __now, or the RTC cache
+#if USYS_TIME_TRIM_LEARN
+      if (!_ext_time)
+         _trim_learn (*t);
+#endif
+      _now_set (*t);
+      return 0;
    }
+   else
+      return -1;
 }
 
 /*!
@@ -221,17 +1308,132 @@ int settime (const time_t *t)
  * \note
  *    All the entries will run in privileged mode and will use the main
  *    stack.
+ * \note
+ *    The entry is linked to the scheduler on the next tick.
+ * \note
+ *    With \ref USYS_CPUS the service runs on the calling core, and only
+ *    service_rem() from the same core removes it.
+ * \return        0 on success, -1 on invalid arguments or a full table
  */
-void service_add (cronfun_t pfun, clock_t tic)
+int service_add (cronfun_t pfun, clock_t tic)
 {
-   uint32_t i;
-   for (i=0 ; i<USYS_CRONTAB_ENTRIES ; ++i)
-      if (!_crontab[i].fun) {
-         _crontab[i].fun = pfun;
-         _crontab[i].tic = tic;
-         return;
+   return service_add_ex (pfun, tic, 0, 0);
+}
+
+/*!
+ * \brief
+ *    Add a function to cron, with service flags
+ *
+ * \param   pfun  Pointer to function
+ * \param   tic   Tick period. Cron will run the \a pfun every \b tic Ticks
+ * \param   phase Tick offset of the first run. Services with the same
+ *                period and different phases run on different ticks.
+ * \param   flags Service flags
+ *    \arg USYS_SRV_DEFERRED   The ISR only queues the service and
+ *                             usys_run_pending() runs it.
+ *    \arg USYS_SRV_STAGGER    Add to \a phase an automatic offset, that
+ *                             spreads the services over the ticks.
+ *    \arg USYS_SRV_CATCHUP    After a late SysTick_Advance() run once for
+ *                             each missed period, instead of once.
+ * \return        0 on success, -1 on invalid arguments or a full table
+ */
+int service_add_ex (cronfun_t pfun, clock_t tic, clock_t phase, uint8_t flags)
+{
+   _cpu_t *c = _CPU;
+   crontab_t *e;
+   int i;
+
+   if (!pfun || !tic)
+      return -1;
+   for (i=0 ; i<USYS_CRONTAB_ENTRIES ; ++i) {
+      e = &c->crontab[i];
+      if (e->state == CRON_FREE && usys_cas (&e->state, CRON_FREE, CRON_CLAIM)) {
+         // The slot is ours, the ISR ignores it until we publish it
+         c->srv[i].fun = pfun;
+         c->srv[i].tic = tic;
+         e->srv = &c->srv[i];
+         e->exp = tic + phase;   // Relative, until linked
+         e->flags = flags & ~USYS_SRV_DEMOTED;
+#if USYS_CRON_BUDGET
+         e->wcet = 0;
+#endif
+         usys_barrier ();        // Release: the fields before the state
+         e->state = CRON_ADD;
+         usys_barrier ();
+         c->dirty = 1;
+         _tick_kick ();
+#if USYS_TICKLESS
+         set_compare (1);     // Wake up to link it and re-program the deadline
+#endif
+         return 0;
+      }
+   }
+   return -1;
+}
+
+#if USYS_CRON_BUDGET
+/*!
+ * \brief
+ *    CPU share of a budget, in 1/65536 of the CPU
+ */
+static uint64_t _cron_util (uint32_t wcet, clock_t tic, uint32_t p) {
+   return ((uint64_t)wcet << 16) / ((uint64_t)tic * p);
+}
+
+/*!
+ * \brief
+ *    Set the worst case execution time of a service and check that the
+ *    services with a budget stay schedulable:
+ *    - The budgets of the services the SysTick ISR runs add up to no more
+ *      than \ref USYS_CRON_ISR_LOAD percent of a tick.
+ *    - The sum of budget / period of all of them is no more than
+ *      \ref USYS_CRON_UTIL_MAX percent.
+ *    A call that runs over the budget moves the service to the deferred
+ *    queue and sets \ref USYS_SRV_DEMOTED, so the ISR can not overrun.
+ * \note
+ *    A measured budget can come from the max of usys_service_stats().
+ *
+ * \param   pfun  Pointer to the service function, added to cron
+ * \param   wcet  Budget in \ref USYS_PROFILE_CYCLES() cycles, 0 removes it
+ * \return        0 on success, -1 if the service is not in cron or the set
+ *                is not schedulable. Then the budget is not changed.
+ */
+int service_budget (cronfun_t pfun, uint32_t wcet)
+{
+   _cpu_t *c = _CPU;
+   crontab_t *e, *s = NULL;
+   uint32_t p = USYS_PROFILE_TICK_CYCLES ();
+   uint64_t isr = 0, util = 0;
+   uint32_t st;
+   int i;
+
+   for (i=0 ; i<_CRON_ALL (c) ; ++i) {
+      e = _cron_entry (c, i);
+      st = e->state;
+      if (st != CRON_ADD && st != CRON_ACTIVE)
+         continue;
+      if (e->srv->fun == pfun)
+         s = e;
+      else if (e->wcet && p) {
+         if (!(e->flags & USYS_SRV_DEFERRED))
+            isr += e->wcet;
+         util += _cron_util (e->wcet, e->srv->tic, p);
       }
+   }
+   if (!s || !p)
+      return -1;
+   if (wcet) {
+      if (!(s->flags & USYS_SRV_DEFERRED))
+         isr += wcet;
+      util += _cron_util (wcet, s->srv->tic, p);
+      if (isr * 100 > (uint64_t)p * USYS_CRON_ISR_LOAD
+       || util * 100 > ((uint64_t)USYS_CRON_UTIL_MAX << 16))
+         return -1;
+   }
+   s->wcet = wcet;
+   return 0;
 }
+#endif
 
 /*!
  * \brief
@@ -241,10 +1443,518 @@ void service_add (cronfun_t pfun, clock_t tic)
  */
 void service_rem (cronfun_t pfun)
 {
+   _cpu_t *c = _CPU;
+   crontab_t *e;
+   uint32_t st;
+   int i;
+   for (i=0 ; i<_CRON_ALL (c) ; ++i) {
+      e = _cron_entry (c, i);
+      do {
+         st = e->state;
+         if ((st != CRON_ADD && st != CRON_ACTIVE) || e->srv->fun != pfun)
+            break;
+         if (usys_cas (&e->state, st, CRON_REM)) {
+            usys_barrier ();
+            c->dirty = 1;
+            _tick_kick ();
+            break;
+         }
+      } while (1);
+   }
+}
+
+/*!
+ * \brief
+ *    Run the deferred services queued by the SysTick ISR.
+ *    The User calls this from the main loop (or a PendSV handler).
+ *
+ * \return  The number of services that run
+ */
+int usys_run_pending (void)
+{
+   _cpu_t *c = _CPU;
+   crontab_t *e;
+   int n = 0;
+
+   while (c->queue_tail != c->queue_head) {
+      e = c->queue[c->queue_tail & _QUEUE_MASK];
+      c->queue_tail = c->queue_tail + 1;
+      e->pend = 0;      // Let the ISR queue it again from now on
+      if (e->state == CRON_ACTIVE) {
+         _cron_call (e);
+         ++n;
+      }
+   }
+   return n;
+}
+
+#if USYS_TIMERS
+/*!
+ * \brief
+ *    Initialize a software timer
+ *
+ * \param   t     Pointer to the User's timer object
+ * \param   fun   The callback. It runs from the SysTick ISR
+ * \param   arg   The callback argument
+ * \param   prio  Priority among the timers due on the same tick. Higher first
+ */
+void usys_timer_init (usys_timer_t *t, timerfun_t fun, void *arg, uint8_t prio)
+{
+   t->fun = fun;
+   t->arg = arg;
+   t->prio = prio;
+   t->period = 0;
+   t->idx = 0;
+}
+
+/*!
+ * \brief
+ *    Arm (or re-arm) a software timer. Safe from any context.
+ * \note
+ *    With \ref USYS_CPUS the timer runs on the calling core. Re-arm and
+ *    cancel it from the same core.
+ *
+ * \param   t        Pointer to an initialized timer
+ * \param   delay    Ticks until the first call
+ * \param   period   Reload period in ticks after each call, or 0 for a one-shot timer
+ * \return           0 on success, -1 if \ref USYS_TIMERS timers are already armed
+ */
+int usys_timer_start (usys_timer_t *t, clock_t delay, clock_t period)
+{
+   _cpu_t *c = _CPU;
+   uint32_t s = usys_irq_save ();
+
+   if (t->idx)
+      _theap_del (c, t);
+   else if (c->theap_n >= USYS_TIMERS) {
+      usys_irq_restore (s);
+      return -1;
+   }
+   t->exp = mclock () + delay;
+   t->period = period;
+   _theap_push (c, t);
+   if (t->idx == 1)
+      _tick_kick ();       // New head
+#if USYS_TICKLESS
+   if (t->idx == 1)
+      set_compare (1);     // New head, wake up to re-program the deadline
+#endif
+   usys_irq_restore (s);
+   return 0;
+}
+
+/*!
+ * \brief
+ *    Cancel a software timer. Safe from any context, the callback does not
+ *    run after this returns.
+ * \param   t     Pointer to timer
+ */
+void usys_timer_stop (usys_timer_t *t)
+{
+   _cpu_t *c = _CPU;
+   uint32_t s = usys_irq_save ();
+   if (t->idx)
+      _theap_del (c, t);
+   usys_irq_restore (s);
+}
+
+/*!
+ * \brief
+ *    Check if a software timer is armed
+ * \return  Non zero if the timer is armed
+ */
+int usys_timer_active (const usys_timer_t *t) {
+   return t->idx != 0;
+}
+#endif   // #if USYS_TIMERS
+
+#if USYS_TICKLESS && USYS_TIMERS
+static void _wake (void *arg) { (void)arg; }
+#endif
+
+/*!
+ * \brief
+ *    Sleep until the next interrupt if the deadline \a dl has not expired.
+ *    The test runs with the interrupts masked, so an interrupt between the
+ *    test and the WFI can not be lost.
+ * \return  Non zero if it slept
+ */
+#if !USYS_TICKLESS || USYS_TIMERS
+static int _sleep_tick (mclock_t dl)
+{
+   uint32_t s = usys_irq_save ();
+   int r = !usys_expired (dl);
+   if (r)   usys_wfi ();
+   usys_irq_restore (s);
+   return r;
+}
+#endif
+
+#if USYS_HIRES_CLOCK && !USYS_TICKLESS
+/*!
+ * \brief
+ *    Same as _sleep_tick() for a usys_cycles() deadline. It sleeps only
+ *    while more than \a per cycles (one tick) remain.
+ */
+static int _sleep_cycles (uint64_t end, uint64_t per)
+{
+   uint32_t s = usys_irq_save ();
+   int r = (int64_t)(end - usys_cycles ()) > (int64_t)per;
+   if (r)   usys_wfi ();
+   usys_irq_restore (s);
+   return r;
+}
+#endif
+
+/*!
+ * \brief
+ *    Wait until a mclock() deadline, see usys_deadline(). The CPU sleeps
+ *    with WFI between the ticks.
+ * \note
+ *    With \ref USYS_TICKLESS a software timer on the deadline wakes the CPU,
+ *    so the wait needs a free timer slot. Without one it busy waits.
+ * \param   dl    The deadline in ticks
+ */
+void usys_wait_until (mclock_t dl)
+{
+#if USYS_TICKLESS
+#if USYS_TIMERS
+   usys_timer_t t;
+
+   usys_timer_init (&t, _wake, NULL, 0);
+   if (!usys_expired (dl) && !usys_timer_start (&t, (clock_t)(dl - mclock ()), 0)) {
+      while (_sleep_tick (dl))
+         ;
+      usys_timer_stop (&t);
+   }
+#endif
+   while (!usys_expired (dl))
+      ;
+#else
+   while (_sleep_tick (dl))
+      ;
+#endif
+}
+
+/*!
+ * \brief
+ *    Delay for at least \a us microseconds
+ *
+ * With \ref USYS_HIRES_CLOCK the CPU sleeps for the whole ticks and spins
+ * on usys_cycles() for the rest, so short delays are cycle accurate.
+ * Otherwise the delay rounds up to whole ticks.
+ */
+static void _delay (uint64_t us)
+{
+   clock_t f = usys_get_freq ();
+#if USYS_HIRES_CLOCK && !USYS_TICKLESS
+   uint64_t per = (uint64_t)get_reload () + 1;
+   uint64_t t = us * f;    // us * f * per overflows for delays of hours
+   uint64_t end = usys_cycles () + (t / 1000000) * per
+                + ((t % 1000000) * per + 999999) / 1000000;
+
+   while (_sleep_cycles (end, per))
+      ;
+   while ((int64_t)(end - usys_cycles ()) > 0)
+      ;
+#else
+   // +1: the current tick is already partly gone
+   usys_wait_until (usys_deadline ((us * f + 999999) / 1000000 + 1));
+#endif
+}
+
+/*!
+ * \brief
+ *    Delay for at least \a us microseconds. See usys_wait_until().
+ * \param   us    The delay in microseconds
+ */
+void usys_delay_us (uint32_t us) {
+   _delay (us);
+}
+
+/*!
+ * \brief
+ *    Delay for at least \a ms milliseconds. See usys_wait_until().
+ * \param   ms    The delay in milliseconds
+ */
+void usys_delay_ms (uint32_t ms) {
+   _delay ((uint64_t)ms * 1000);
+}
+
+/*!
+ * \brief
+ *    Set event bits. Safe from any context, for ex: from an ISR or a cron
+ *    service. A usys_event_wait() sleeping on them wakes up on the return
+ *    of the interrupt.
+ * \param   ev    Pointer to the event flags
+ * \param   bits  The bits to set
+ */
+void usys_event_set (usys_event_t *ev, uint32_t bits)
+{
+   uint32_t v;
+   do
+      v = ev->bits;
+   while (!usys_cas (&ev->bits, v, v | bits));
+}
+
+/*!
+ * \brief
+ *    Clear event bits. Safe from any context.
+ * \param   ev    Pointer to the event flags
+ * \param   bits  The bits to clear
+ */
+void usys_event_clear (usys_event_t *ev, uint32_t bits)
+{
+   uint32_t v;
+   do
+      v = ev->bits;
+   while (!usys_cas (&ev->bits, v, v & ~bits));
+}
+
+/*!
+ * \brief
+ *    Test the wait condition and with \ref USYS_EVENT_CLEAR consume the
+ *    bits in the same atomic step.
+ * \return  The bits that satisfied the wait, or 0
+ */
+static uint32_t _event_take (usys_event_t *ev, uint32_t bits, uint8_t mode)
+{
+   uint32_t v, m;
+   do {
+      v = ev->bits;
+      m = v & bits;
+      if (!m || ((mode & USYS_EVENT_ALL) && m != bits))
+         return 0;
+      if (!(mode & USYS_EVENT_CLEAR))
+         return m;
+   } while (!usys_cas (&ev->bits, v, v & ~m));
+   return m;
+}
+
+/*!
+ * \brief
+ *    Wait for event bits, with a timeout. The CPU sleeps with WFI while
+ *    the bits are clear. The bits are tested with the interrupts masked
+ *    before each sleep, so a usys_event_set() from an ISR is never missed.
+ * \note
+ *    With \ref USYS_TICKLESS a software timer on the deadline wakes the CPU
+ *    for the timeout. With no free timer slot the timeout busy waits.
+ *    With \ref USYS_CPUS, a set from another core is seen on the next tick.
+ *
+ * \param   ev       Pointer to the event flags
+ * \param   bits     The bits to wait for
+ * \param   mode     \ref USYS_EVENT_ANY or \ref USYS_EVENT_ALL, or-ed with
+ *                   \ref USYS_EVENT_CLEAR to consume the bits
+ * \param   timeout  Timeout in ticks, 0 to poll or \ref USYS_EVENT_FOREVER
+ * \return           The bits that satisfied the wait, or 0 on timeout
+ */
+uint32_t usys_event_wait (usys_event_t *ev, uint32_t bits, uint8_t mode, clock_t timeout)
+{
+   mclock_t dl = usys_deadline (timeout);
+   int sleep = 1;
+   uint32_t r, s;
+#if USYS_TICKLESS && USYS_TIMERS
+   usys_timer_t t;
+
+   usys_timer_init (&t, _wake, NULL, 0);
+   if (timeout && timeout != USYS_EVENT_FOREVER)
+      sleep = !usys_timer_start (&t, timeout, 0);
+#elif USYS_TICKLESS
+   sleep = (timeout == USYS_EVENT_FOREVER);  // Nothing would wake us on the deadline
+#endif
+
+   while (!(r = _event_take (ev, bits, mode))) {
+      if (timeout != USYS_EVENT_FOREVER && usys_expired (dl))
+         break;
+      if (!sleep)
+         continue;
+      s = usys_irq_save ();
+      if (!(ev->bits & bits)
+            || ((mode & USYS_EVENT_ALL) && (ev->bits & bits) != bits)) {
+         if (timeout == USYS_EVENT_FOREVER || !usys_expired (dl))
+            usys_wfi ();
+      }
+      usys_irq_restore (s);
+   }
+#if USYS_TICKLESS && USYS_TIMERS
+   usys_timer_stop (&t);
+#endif
+   return r;
+}
+
+#if USYS_PROFILE
+/*!
+ * \brief
+ *    Take a snapshot of a service's runtime statistics.
+ * \note
+ *    Statistics of deferred services are updated by usys_run_pending(),
+ *    so read them from the same context.
+ *
+ * \param   pfun  Pointer to the service function
+ * \param   st    Pointer to return the statistics
+ * \return        0 on success, -1 if the service is not in cron
+ */
+int usys_service_stats (cronfun_t pfun, usys_stat_t *st)
+{
+   _cpu_t *c = _CPU;
+   crontab_t *e;
+   uint32_t s;
+   int i;
+
+   for (i=0 ; i<_CRON_ALL (c) ; ++i) {
+      e = _cron_entry (c, i);
+      if (e->state == CRON_ACTIVE && e->srv->fun == pfun) {
+         do {
+            s = c->prof_seq;
+            *st = e->stat;
+         } while (s != c->prof_seq);
+         return 0;
+      }
+   }
+   return -1;
+}
+
+/*!
+ * \brief
+ *    Take a snapshot of the SysTick_Callback() statistics
+ * \param   st    Pointer to return the statistics
+ */
+void usys_isr_stats (usys_isr_stat_t *st)
+{
+   _cpu_t *c = _CPU;
+   uint32_t s;
+   do {
+      s = c->prof_seq;
+      *st = c->prof_isr;
+   } while (s != c->prof_seq);
+}
+
+/*!
+ * \brief
+ *    Clear the ISR and the service statistics
+ */
+void usys_stats_reset (void)
+{
+   _cpu_t *c = _CPU;
+   uint32_t s;
    int i;
-   for (i=0 ; i<USYS_CRONTAB_ENTRIES ; ++i)
-      if (_crontab[i].fun == pfun)
-         _crontab[i].fun = (void*)0;
+   do {
+      s = c->prof_seq;
+      memset (&c->prof_isr, 0, sizeof (c->prof_isr));
+      for (i=0 ; i<_CRON_ALL (c) ; ++i) {
+         memset (&_cron_entry (c, i)->stat, 0, sizeof (usys_stat_t));
+#if USYS_PROFILE_JITTER
+         memset (&_cron_entry (c, i)->jit, 0, sizeof (usys_jitter_t));
+#endif
+      }
+   } while (s != c->prof_seq);
+}
+
+#if USYS_PROFILE_JITTER
+/*!
+ * \brief
+ *    Take a snapshot of a service's start time error statistics.
+ *    The first start after service_add() or usys_stats_reset() only
+ *    stamps the service.
+ * \note
+ *    Deferred services are stamped by usys_run_pending(), so their error
+ *    includes the queueing delay. Read them from the same context.
+ *
+ * \param   pfun  Pointer to the service function
+ * \param   st    Pointer to return the statistics
+ * \return        0 on success, -1 if the service is not in cron
+ */
+int usys_service_jitter (cronfun_t pfun, usys_jitter_t *st)
+{
+   _cpu_t *c = _CPU;
+   crontab_t *e;
+   uint32_t s;
+   int i;
+
+   for (i=0 ; i<_CRON_ALL (c) ; ++i) {
+      e = _cron_entry (c, i);
+      if (e->state == CRON_ACTIVE && e->srv->fun == pfun) {
+         do {
+            s = c->prof_seq;
+            *st = e->jit;
+         } while (s != c->prof_seq);
+         return 0;
+      }
+   }
+   return -1;
 }
 
+/*!
+ * Drift measurement state. The RTC second edges are caught by polling, so
+ * the measurement starts and ends on an edge.
+ */
+static struct {
+   uint8_t     state;   //!< 0: reset, 1: waiting for the first edge, 2: measuring
+   time_t      ext0;    //!< RTC time at the first edge
+   time_t      ext;     //!< RTC time at the last edge
+   mclock_t    t0;      //!< mclock() at the first edge
+   mclock_t    t;       //!< mclock() at the last edge
+}_drift;
+
+/*!
+ * \brief
+ *    Measure the drift of the time base against the RTC set by
+ *    usys_set_rtc_time(). Each call polls the RTC and stamps its second
+ *    edges with mclock(), so call it often (for ex: from the main loop) for
+ *    a one tick error at the edges. The result is good to
+ *    1e6 / (secs * freq) ppm. The measured ticks over secs give the actual
+ *    time base frequency, for calibrating usys_set_freq().
+ * \note
+ *    Call it from a single context.
+ *
+ * \param   d     Pointer to return the measurement
+ * \return        0 on success, -1 if there is no RTC or no full second yet
+ */
+int usys_drift (usys_drift_t *d)
+{
+   time_t e;
+   mclock_t m;
+   int64_t n;
+
+   if (!_ext_time)
+      return -1;
+   m = mclock ();
+   if ((e = _ext_time (NULL)) == (time_t)-1)
+      return -1;
+   switch (_drift.state) {
+      case 0:
+         _drift.ext = e;
+         _drift.state = 1;
+         return -1;
+      case 1:
+         if (e == _drift.ext)
+            return -1;
+         _drift.ext0 = _drift.ext = e;
+         _drift.t0 = _drift.t = m;
+         _drift.state = 2;
+         return -1;
+      default:
+         if (e != _drift.ext) {
+            _drift.ext = e;
+            _drift.t = m;
+         }
+         break;
+   }
+   if (_drift.ext == _drift.ext0)
+      return -1;
+   d->secs = (uint32_t)(_drift.ext - _drift.ext0);
+   d->ticks = _drift.t - _drift.t0;
+   n = (int64_t)d->secs * usys_get_freq ();
+   d->ppm = (n) ? (int32_t)(((int64_t)d->ticks - n) * 1000000 / n) : 0;
+   return 0;
+}
 
+/*!
+ * \brief
+ *    Restart the drift measurement, for ex: after usys_set_freq()
+ */
+void usys_drift_reset (void) {
+   _drift.state = 0;
+}
+#endif   // #if USYS_PROFILE_JITTER
+#endif   // #if USYS_PROFILE
@@ -0,0 +1,113 @@
+/*
+ * \file usystrace.c
+ * \brief
+ *    Binary trace log. Fixed size records with a timestamp in a lock-free
+ *    ring, for tracing at high event rates without format parsing.
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <usystrace.h>
+#include <usystime.h>
+#include <usysport.h>
+
+#if USYS_TRACE
+#define  _TRACE_MASK    (USYS_TRACE_SIZE - 1)
+
+/*
+ * ============ Static Data ============
+ */
+static usys_trace_rec_t _trace[USYS_TRACE_SIZE];
+static volatile uint32_t _trace_head;  //!< Next sequence number to reserve, all producers
+static uint32_t _trace_tail;           //!< Next sequence number to read, the reader only
+
+/*
+ * ============ Public API ============
+ */
+
+/*!
+ * \brief
+ *    Write a trace record. Safe from any context. Use it via usys_trace().
+ *
+ * \param   id    Event id, below \ref USYS_TRACE_ID_SERVICE
+ * \param   arg   Event argument
+ */
+void usys_trace_put (uint16_t id, uint32_t arg)
+{
+   usys_trace_rec_t *r;
+   uint32_t h;
+
+   do
+      h = _trace_head;
+   while (!usys_cas (&_trace_head, h, h + 1));
+   r = &_trace[h & _TRACE_MASK];
+   r->seq = 0;          // Unpublished while we write it
+   usys_barrier ();
+   r->stamp = USYS_TRACE_STAMP ();
+   r->id = id;
+   r->res = 0;
+   r->arg = arg;
+   usys_barrier ();     // Release: the fields before the sequence
+   r->seq = h + 1;
+}
+
+/*!
+ * \brief
+ *    Read the oldest trace records, in order. If the writers overwrote
+ *    records before they were read, a \ref USYS_TRACE_ID_LOST record with
+ *    the count comes first.
+ * \note
+ *    Call it from a single context, for ex: the main loop.
+ *
+ * \param   dst   Pointer to receive the records
+ * \param   n     Maximum number of records
+ * \return        The number of records read
+ */
+uint32_t usys_trace_read (usys_trace_rec_t *dst, uint32_t n)
+{
+   usys_trace_rec_t *r;
+   uint32_t cnt = 0, h, lost;
+
+   while (cnt < n) {
+      h = _trace_head;
+      if (h - _trace_tail > USYS_TRACE_SIZE) {
+         // Overwritten, skip to the oldest record still in the ring
+         lost = h - _trace_tail - USYS_TRACE_SIZE;
+         _trace_tail += lost;
+         dst[cnt].seq = _trace_tail;
+         dst[cnt].stamp = USYS_TRACE_STAMP ();
+         dst[cnt].id = USYS_TRACE_ID_LOST;
+         dst[cnt].res = 0;
+         dst[cnt].arg = lost;
+         ++cnt;
+         continue;
+      }
+      r = &_trace[_trace_tail & _TRACE_MASK];
+      if (r->seq != _trace_tail + 1)
+         break;         // Not published yet
+      usys_barrier ();  // Acquire: the fields after the sequence
+      dst[cnt] = *r;
+      usys_barrier ();
+      if (r->seq != _trace_tail + 1)
+         continue;      // Overwritten during the copy, count it as lost
+      ++_trace_tail;
+      ++cnt;
+   }
+   return cnt;
+}
+#endif   // #if USYS_TRACE
@@ -0,0 +1,67 @@
+/*
+ * \file test.c
+ * \brief
+ *    Unit tests of usys over the host simulation. Each suite reports its
+ *    failed checks and the exit status is non zero if any failed.
+ *
+ *    usage: usys_test
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <test.h>
+
+uint32_t test_fails = 0;
+
+/*!
+ * \brief
+ *    Run \a n ticks of the time base
+ */
+void test_ticks (clock_t n)
+{
+   while (n--)
+      SysTick_Callback ();
+}
+
+/*!
+ * \brief
+ *    Run a suite and print its result
+ */
+static void _run (const char *name, void (*suite) (void))
+{
+   uint32_t f = test_fails;
+
+   suite ();
+   printf ("%-12s %s\n", name, (test_fails == f) ? "ok" : "FAIL");
+}
+
+int main (void)
+{
+   _run ("cron", test_cron);
+   _run ("timer", test_timer);
+#if USYS_TICKLESS
+   _run ("tickless", test_tickless);
+#endif
+   _run ("ring", test_ring);
+   _run ("pool", test_pool);
+   _run ("heap", test_heap);
+#if USYS_MEMMON
+   _run ("memmon", test_memmon);
+#endif
+   return (test_fails) ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * \file test.h
+ * \brief
+ *    Minimal unit test checks for the host simulation build
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef __test_h__
+#define __test_h__
+
+#include <usys_sim.h>
+#include <stdio.h>
+
+/*!
+ * Number of failed checks
+ */
+extern uint32_t test_fails;
+
+/*!
+ * Check \a _c_ and report the failure, the test goes on
+ */
+#define  TEST_CHECK(_c_)   do {                                         \
+   if (!(_c_)) {                                                        \
+      ++test_fails;                                                     \
+      printf ("%s:%d: check failed: %s\n", __FILE__, __LINE__, #_c_);   \
+   }                                                                    \
+} while (0)
+
+/*!
+ * Check that the integers \a _a_ and \a _b_ are equal and report both
+ */
+#define  TEST_EQ(_a_, _b_) do {                                         \
+   long long _va = (long long)(_a_), _vb = (long long)(_b_);            \
+   if (_va != _vb) {                                                    \
+      ++test_fails;                                                     \
+      printf ("%s:%d: check failed: %s == %s (%lld != %lld)\n",         \
+              __FILE__, __LINE__, #_a_, #_b_, _va, _vb);                \
+   }                                                                    \
+} while (0)
+
+void test_ticks (clock_t n);
+
+void test_cron (void);
+void test_timer (void);
+void test_tickless (void);
+void test_ring (void);
+void test_pool (void);
+void test_heap (void);
+void test_memmon (void);
+
+#endif // #ifndef __test_h__
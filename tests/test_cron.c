@@ -0,0 +1,254 @@
+/*
+ * \file test_cron.c
+ * \brief
+ *    Unit tests of the cron scheduler: the wheel, the phase and stagger
+ *    placement, the deferred services and the catch-up of SysTick_Advance()
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <test.h>
+
+#define  _LOG        (64)
+
+/*!
+ * Call log of a service, the mclock() of each call
+ */
+typedef struct {
+   uint32_t    n;
+   mclock_t    t[_LOG];
+}_log_t;
+
+static void _log (_log_t *l) {
+   if (l->n < _LOG)
+      l->t[l->n] = mclock ();
+   ++l->n;
+}
+
+static _log_t _la, _lb, _lc, _ld, _ls;
+static void _a (void) { _log (&_la); }
+static void _b (void) { _log (&_lb); }
+static void _c (void) { _log (&_lc); }
+static void _d (void) { _log (&_ld); }
+static void _st (void) { _log (&_ls); }
+static void _nop (void) { }
+
+// A static service, linked on the first tick
+USYS_SERVICE (_st, 25);
+
+/*!
+ * \brief
+ *    Remove the services and clear their logs
+ */
+static void _reset (void)
+{
+   service_rem (_a);
+   service_rem (_b);
+   service_rem (_c);
+   service_rem (_d);
+   test_ticks (1);
+   _la.n = _lb.n = _lc.n = _ld.n = 0;
+}
+
+/*!
+ * \brief
+ *    Check that the logged calls are \a p ticks apart
+ */
+static void _check_period (const _log_t *l, clock_t p)
+{
+   uint32_t i;
+
+   TEST_CHECK (l->n > 1);
+   for (i=1 ; i<l->n && i<_LOG ; ++i)
+      TEST_EQ (l->t[i] - l->t[i-1], p);
+}
+
+/*!
+ * \brief
+ *    Periods shorter and longer than the wheel run on every period
+ */
+static void _wheel (void)
+{
+   TEST_EQ (service_add (_a, 1), 0);
+   TEST_EQ (service_add (_b, 7), 0);
+   TEST_EQ (service_add (_c, USYS_CRON_WHEEL_SLOTS + 9), 0);
+   TEST_EQ (service_add (_d, 100), 0);
+   test_ticks (1000);
+   TEST_EQ (_la.n, 1000);     // The first call is one period after the add
+   TEST_EQ (_lb.n, 1000 / 7);
+   _check_period (&_la, 1);
+   _check_period (&_lb, 7);
+   _check_period (&_lc, USYS_CRON_WHEEL_SLOTS + 9);
+   _check_period (&_ld, 100);
+   TEST_EQ (_ld.n, 10);
+   _reset ();
+   test_ticks (100);
+   TEST_EQ (_la.n + _lb.n + _lc.n + _ld.n, 0);
+
+   _check_period (&_ls, 25);
+}
+
+/*!
+ * \brief
+ *    A full table reports it, and a removed service does not run
+ */
+static void _table (void)
+{
+   int n = 0;
+
+   TEST_EQ (service_add (_a, 0), -1);
+   TEST_EQ (service_add ((cronfun_t)0, 1), -1);
+   while (service_add (_nop, 3) == 0)
+      ++n;
+   TEST_CHECK (n > 0 && n <= USYS_CRONTAB_ENTRIES);
+   TEST_EQ (service_add (_a, 1), -1);
+   test_ticks (10);
+   service_rem (_nop);
+   test_ticks (1);
+   TEST_EQ (service_add (_a, 1), 0);
+   test_ticks (10);
+   TEST_EQ (_la.n, 10);
+   _reset ();
+}
+
+/*!
+ * \brief
+ *    The phase shifts the calls of the same period, the stagger spreads
+ *    them on different ticks
+ */
+static void _phase (void)
+{
+   uint32_t i, j;
+   uint32_t m[4];
+
+   service_add_ex (_a, 10, 0, 0);
+   service_add_ex (_b, 10, 3, 0);
+   test_ticks (105);
+   TEST_EQ (_la.n, _lb.n);
+   for (i=0 ; i<_la.n && i<_LOG ; ++i)
+      TEST_EQ (_lb.t[i] - _la.t[i], 3);
+   _reset ();
+
+   service_add_ex (_a, 8, 0, USYS_SRV_STAGGER);
+   service_add_ex (_b, 8, 0, USYS_SRV_STAGGER);
+   service_add_ex (_c, 8, 0, USYS_SRV_STAGGER);
+   service_add_ex (_d, 8, 0, USYS_SRV_STAGGER);
+   test_ticks (40);
+   m[0] = _la.t[0] % 8;  m[1] = _lb.t[0] % 8;
+   m[2] = _lc.t[0] % 8;  m[3] = _ld.t[0] % 8;
+   for (i=0 ; i<4 ; ++i)
+      for (j=i+1 ; j<4 ; ++j)
+         TEST_CHECK (m[i] != m[j]);
+   _check_period (&_la, 8);
+   _check_period (&_ld, 8);
+   _reset ();
+}
+
+/*!
+ * \brief
+ *    A deferred service runs from usys_run_pending() only, once per period
+ */
+static void _deferred (void)
+{
+   service_add_ex (_a, 5, 0, USYS_SRV_DEFERRED);
+   test_ticks (20);
+   TEST_EQ (_la.n, 0);
+   TEST_EQ (usys_run_pending (), 1);      // Queued once, not once per period
+   TEST_EQ (_la.n, 1);
+   TEST_EQ (usys_run_pending (), 0);
+   test_ticks (5);
+   TEST_EQ (usys_run_pending (), 1);
+   _reset ();
+   usys_run_pending ();
+}
+
+/*!
+ * \brief
+ *    SysTick_Advance() runs the overdue services once, or once per missed
+ *    period with USYS_SRV_CATCHUP, and keeps their phase
+ */
+static void _catchup (void)
+{
+   uint32_t n;
+
+   service_add (_a, 10);
+   service_add_ex (_b, 10, 0, USYS_SRV_CATCHUP);
+   test_ticks (10);
+   TEST_EQ (_la.n, 1);
+   TEST_EQ (_lb.n, 1);
+   SysTick_Advance (30);
+   TEST_EQ (_la.n, 2);
+   TEST_EQ (_lb.n, 4);
+   n = _la.n;
+   test_ticks (100);
+   TEST_EQ (_la.n - n, 10);
+   TEST_EQ ((_la.t[n] - _la.t[0]) % 10, 0);
+   TEST_EQ (_la.t[_la.n - 1] - _la.t[n], 90);
+   TEST_EQ (_lb.t[_lb.n - 1] - _la.t[_la.n - 1], 0);
+   _reset ();
+}
+
+/*!
+ * \brief
+ *    SysTick_Advance() a few ticks after a call, when the tick fast path
+ *    has not moved the wheel since
+ */
+static void _catchup_late (void)
+{
+   uint32_t n;
+
+   service_add (_a, 10);
+   test_ticks (105);
+   TEST_EQ (_la.n, 10);
+   TEST_CHECK (usys_next_deadline () <= 5);     // The static service can be sooner
+   SysTick_Advance (50);
+   TEST_EQ (_la.n, 11);
+   n = _la.n;
+   test_ticks (200);
+   TEST_EQ (_la.n - n, 20);
+   TEST_EQ ((_la.t[n] - _la.t[0]) % 10, 0);      // On the same phase
+   for (++n ; n<_la.n && n<_LOG ; ++n)
+      TEST_EQ (_la.t[n] - _la.t[n-1], 10);
+   _reset ();
+}
+
+/*!
+ * \brief
+ *    service_rem() stops a static service too
+ */
+static void _static (void)
+{
+   uint32_t n;
+
+   TEST_CHECK (_ls.n > 0);
+   service_rem (_st);
+   n = _ls.n;
+   test_ticks (100);
+   TEST_EQ (_ls.n, n);
+}
+
+void test_cron (void)
+{
+   _wheel ();
+   _table ();
+   _phase ();
+   _deferred ();
+   _catchup ();
+   _catchup_late ();
+   _static ();
+}
@@ -0,0 +1,124 @@
+/*
+ * \file test_mem.c
+ * \brief
+ *    Unit tests of the object pools and of the usys heap
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <test.h>
+#include <string.h>
+#include <errno.h>
+
+USYS_POOL_DEF (_pool, 12, 4);
+
+void test_pool (void)
+{
+   void *o[5];
+   uint32_t i, j;
+
+   for (i=0 ; i<4 ; ++i) {
+      TEST_CHECK ((o[i] = usys_pool_alloc (&_pool)) != NULL);
+      TEST_EQ ((uintptr_t)o[i] & 3, 0);
+      memset (o[i], (int)i, 12);
+   }
+   for (i=0 ; i<4 ; ++i)
+      for (j=i+1 ; j<4 ; ++j)
+         TEST_CHECK (o[i] != o[j]);
+   TEST_CHECK (usys_pool_alloc (&_pool) == NULL);
+   TEST_EQ (_pool.used, 4);
+   TEST_EQ (_pool.hwm, 4);
+
+   usys_pool_free (&_pool, o[2]);
+   TEST_EQ (_pool.used, 3);
+   TEST_CHECK ((o[4] = usys_pool_alloc (&_pool)) == o[2]);
+   TEST_EQ (((uint8_t *)o[1])[11], 1);   // The neighbours are intact
+   TEST_EQ (((uint8_t *)o[3])[0], 3);
+   for (i=0 ; i<4 ; ++i)
+      usys_pool_free (&_pool, o[i]);
+   TEST_EQ (_pool.used, 0);
+   TEST_EQ (_pool.hwm, 4);
+}
+
+void test_heap (void)
+{
+   uint8_t *p, *q;
+   uint32_t i;
+
+   TEST_CHECK ((p = usys_malloc (100)) != NULL);
+   TEST_EQ ((uintptr_t)p & 7, 0);
+   for (i=0 ; i<100 ; ++i)
+      p[i] = (uint8_t)i;
+
+   // Grow and shrink keep the data
+   TEST_CHECK ((q = usys_realloc (p, 1000)) != NULL);
+   for (i=0 ; i<100 && q[i] == (uint8_t)i ; ++i)
+      ;
+   TEST_EQ (i, 100);
+   TEST_CHECK ((p = usys_realloc (q, 40)) != NULL);
+   for (i=0 ; i<40 && p[i] == (uint8_t)i ; ++i)
+      ;
+   TEST_EQ (i, 40);
+   usys_free (p);
+
+   // A freed block is reused for the same size class
+   p = usys_malloc (24);
+   usys_free (p);
+   TEST_CHECK (usys_malloc (24) == p);
+   usys_free (p);
+
+   TEST_CHECK ((p = usys_realloc (NULL, 16)) != NULL);
+   usys_free (p);
+   TEST_CHECK ((p = usys_calloc (8, 16)) != NULL);
+   for (i=0 ; i<128 && !p[i] ; ++i)
+      ;
+   TEST_EQ (i, 128);
+   usys_free (p);
+   usys_free (NULL);
+
+   errno = 0;
+   TEST_CHECK (usys_malloc ((size_t)-1) == NULL);
+   TEST_EQ (errno, ENOMEM);
+   TEST_CHECK (usys_calloc ((size_t)-1 / 2, 4) == NULL);
+}
+
+#if USYS_MEMMON
+static void _nop (void) { }
+
+void test_memmon (void)
+{
+   usys_memmon_t r;
+   int i;
+
+   // A full crontab leaves the monitor out and says so
+   for (i=0 ; i<USYS_CRONTAB_ENTRIES && service_add (_nop, 1) == 0 ; ++i)
+      ;
+   TEST_EQ (usys_memmon_init (), -1);
+   service_rem (_nop);
+   test_ticks (1);
+
+   TEST_EQ (usys_memmon_init (), 0);
+   usys_memmon_report (&r);
+   TEST_CHECK (r.top > r.base);
+   // One pass over the painted words, a few ticks to link and phase the service
+   test_ticks ((clock_t)((r.top - r.base) / 4 / USYS_MEMMON_WORDS + 10));
+   usys_memmon_report (&r);
+   TEST_CHECK (r.passes > 0);
+   TEST_EQ (r.stack_min, r.top);    // Nothing runs in the painted area
+}
+#endif
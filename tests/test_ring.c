@@ -0,0 +1,153 @@
+/*
+ * \file test_ring.c
+ * \brief
+ *    Unit tests of the ring buffer
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <test.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define  _STREAM     (1UL << 18)
+
+static uint8_t _sbuf[64];
+static usys_ring_t _sr = USYS_RING_INIT (_sbuf);
+static volatile uint32_t _sbad;
+
+/*!
+ * \brief
+ *    Consumer of the stress test, checks the byte sequence
+ */
+static void *_consumer (void *arg)
+{
+   uint8_t out[48];
+   uint32_t k = 0, n, i;
+
+   (void)arg;
+   while (k < _STREAM) {
+      if (!(n = usys_ring_read (&_sr, out, 1 + k % sizeof (out))))
+         sched_yield ();   // Let the producer run on a single CPU
+      for (i=0 ; i<n ; ++i)
+         if (out[i] != (uint8_t)(k + i))
+            ++_sbad;
+      k += n;
+   }
+   return NULL;
+}
+
+/*!
+ * \brief
+ *    A producer and a consumer on their own threads. A write never takes
+ *    more than it was given, whatever the consumer does meanwhile.
+ */
+static void _stress (void)
+{
+   uint8_t in[256 + 64];
+   uint32_t k = 0, n, len, over = 0;
+   pthread_t th;
+
+   for (n=0 ; n<sizeof (in) ; ++n)
+      in[n] = (uint8_t)n;
+   _sbad = 0;
+   TEST_EQ (pthread_create (&th, NULL, _consumer, NULL), 0);
+   while (k < _STREAM) {
+      len = 1 + k % 37;
+      if (len > _STREAM - k)
+         len = _STREAM - k;
+      if (!(n = usys_ring_write (&_sr, &in[k & 0xFF], len)))
+         sched_yield ();
+      if (n > len)
+         ++over;
+      k += n;
+   }
+   pthread_join (th, NULL);
+   TEST_EQ (over, 0);
+   TEST_EQ (_sbad, 0);
+}
+
+/*!
+ * \brief
+ *    Copy in and out across the end of the storage, the zero copy spans,
+ *    the clamp of the writes to the free space and the DMA overrun
+ */
+void test_ring (void)
+{
+   static uint8_t buf[16];
+   usys_ring_t r = USYS_RING_INIT (buf);
+   uint8_t in[32], out[32], *w;
+   const uint8_t *p;
+   uint32_t i, n;
+
+   for (i=0 ; i<sizeof (in) ; ++i)
+      in[i] = (uint8_t)(i + 1);
+
+   TEST_EQ (usys_ring_count (&r), 0);
+   TEST_EQ (usys_ring_free (&r), 16);
+   TEST_EQ (usys_ring_write (&r, in, 10), 10);
+   TEST_EQ (usys_ring_read (&r, out, 32), 10);
+   TEST_CHECK (!memcmp (in, out, 10));
+
+   // Wrap
+   TEST_EQ (usys_ring_write (&r, in, 12), 12);
+   TEST_EQ (usys_ring_count (&r), 12);
+   TEST_EQ (usys_ring_peek (&r, &p), 6);       // Up to the end of the storage
+   TEST_CHECK (!memcmp (p, in, 6));
+   usys_ring_consume (&r, 6);
+   TEST_EQ (usys_ring_peek (&r, &p), 6);
+   TEST_CHECK (!memcmp (p, in + 6, 6));
+   usys_ring_consume (&r, 6);
+   TEST_EQ (usys_ring_count (&r), 0);
+
+   // The write is clamped to the free space, never more than asked
+   TEST_EQ (usys_ring_write (&r, in, 5), 5);
+   TEST_EQ (usys_ring_write (&r, in + 5, 32), 11);
+   TEST_EQ (usys_ring_write (&r, in, 1), 0);
+   TEST_EQ (usys_ring_free (&r), 0);
+   TEST_EQ (usys_ring_read (&r, out, 3), 3);
+   TEST_EQ (usys_ring_write (&r, in + 16, 2), 2);
+   TEST_EQ (usys_ring_read (&r, out + 3, 32), 15);
+   TEST_CHECK (!memcmp (in, out, 18));
+
+   // Direct producer
+   n = usys_ring_span (&r, &w);
+   TEST_CHECK (n > 0 && n <= 16);
+   memcpy (w, in, n);
+   usys_ring_produce (&r, n);
+   TEST_EQ (usys_ring_count (&r), n);
+   TEST_EQ (usys_ring_read (&r, out, 32), n);
+   TEST_CHECK (!memcmp (in, out, n));
+
+   // A circular DMA that laps the consumer loses the oldest bytes only
+   usys_ring_init (&r, buf, sizeof (buf));
+   for (i=0 ; i<sizeof (buf) ; ++i)
+      buf[i] = (uint8_t)i;
+   usys_ring_dma_pos (&r, 8);
+   TEST_EQ (usys_ring_count (&r), 8);
+   usys_ring_dma_pos (&r, 0);
+   usys_ring_dma_pos (&r, 8);          // 24 bytes in a 16 byte ring
+   TEST_EQ (usys_ring_count (&r), 16);
+   TEST_EQ (r.lost, 8);
+   TEST_EQ (usys_ring_read (&r, out, 32), 16);
+   TEST_EQ (out[0], 8);
+   TEST_EQ (usys_ring_count (&r), 0);
+
+   _stress ();
+}
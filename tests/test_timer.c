@@ -0,0 +1,131 @@
+/*
+ * \file test_timer.c
+ * \brief
+ *    Unit tests of the software timers and of the tickless deadline
+ *    programming
+ *
+ * This file is part of usys
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <test.h>
+
+static int _order[8];
+static uint32_t _n;
+static mclock_t _at[16];
+
+static void _tfun (void *arg) {
+   if (_n < sizeof (_order) / sizeof (_order[0]))
+      _order[_n] = (int)(intptr_t)arg;
+   if (_n < sizeof (_at) / sizeof (_at[0]))
+      _at[_n] = mclock ();
+   ++_n;
+}
+
+/*!
+ * \brief
+ *    The earlier deadline runs first and the higher priority first on the
+ *    same deadline. A periodic timer reloads without drift.
+ */
+void test_timer (void)
+{
+   usys_timer_t a, b, c, p;
+   uint32_t i;
+
+   usys_timer_init (&a, _tfun, (void *)1, 0);
+   usys_timer_init (&b, _tfun, (void *)2, 2);
+   usys_timer_init (&c, _tfun, (void *)3, 0);
+   _n = 0;
+   TEST_EQ (usys_timer_start (&a, 5, 0), 0);
+   TEST_EQ (usys_timer_start (&b, 5, 0), 0);
+   TEST_EQ (usys_timer_start (&c, 3, 0), 0);
+   TEST_CHECK (usys_timer_active (&a));
+   test_ticks (10);
+   TEST_EQ (_n, 3);
+   TEST_EQ (_order[0], 3);
+   TEST_EQ (_order[1], 2);
+   TEST_EQ (_order[2], 1);
+   TEST_CHECK (!usys_timer_active (&a));
+
+   // Re-arm moves the deadline, stop cancels it
+   _n = 0;
+   usys_timer_start (&a, 5, 0);
+   usys_timer_start (&b, 8, 0);
+   test_ticks (3);
+   usys_timer_start (&a, 10, 0);
+   usys_timer_stop (&b);
+   test_ticks (9);
+   TEST_EQ (_n, 0);
+   test_ticks (1);
+   TEST_EQ (_n, 1);
+
+   usys_timer_init (&p, _tfun, (void *)4, 0);
+   _n = 0;
+   usys_timer_start (&p, 7, 7);
+   test_ticks (70);
+   TEST_EQ (_n, 10);
+   for (i=1 ; i<_n ; ++i)
+      TEST_EQ (_at[i] - _at[i-1], 7);
+   usys_timer_stop (&p);
+   test_ticks (20);
+   TEST_EQ (_n, 10);
+}
+
+#if USYS_TICKLESS
+static uint32_t _calls;
+static mclock_t _last;
+static void _srv (void) { ++_calls; _last = mclock (); }
+
+/*!
+ * \brief
+ *    Each SysTick_Advance() programs the compare to the next deadline, so
+ *    the wake ups land on the deadlines and nothing runs late
+ */
+void test_tickless (void)
+{
+   usys_timer_t t;
+   mclock_t m, prev = 0;
+   uint32_t i;
+
+   TEST_EQ (service_add (_srv, 20), 0);
+   TEST_EQ (usys_sim_compare, 1);         // Wake up to link it
+   SysTick_Advance (1);
+   for (i=0 ; i<50 ; ++i) {
+      TEST_CHECK (usys_sim_compare >= 1 && usys_sim_compare <= 20);
+      TEST_EQ (usys_next_deadline (), usys_sim_compare);
+      SysTick_Advance (usys_sim_compare);
+      if (_calls == 1)
+         prev = _last;
+   }
+   TEST_CHECK (_calls > 10);
+   TEST_EQ ((_last - prev) % 20, 0);
+   TEST_EQ (_last - prev, (mclock_t)(_calls - 1) * 20);
+
+   usys_timer_init (&t, _tfun, (void *)5, 0);
+   _n = 0;
+   m = mclock ();
+   usys_timer_start (&t, 5, 0);
+   TEST_EQ (usys_sim_compare, 1);
+   SysTick_Advance (1);
+   TEST_CHECK (usys_sim_compare <= 4);
+   while (!_n)
+      SysTick_Advance (usys_sim_compare);
+   TEST_EQ (_at[0] - m, 5);
+   service_rem (_srv);
+   SysTick_Advance (1);
+}
+#endif
@@ -0,0 +1,163 @@
+/*
+ * \file usys_tracedec.c
+ * \brief
+ *    Host decoder of the usys binary trace log. Reads the raw records, as
+ *    usys_trace_read() returns them, and prints them one per line.
+ *
+ *    usys_tracedec [-f freq] [-n names] [file]
+ *
+ *    -f freq     Stamp frequency in Hz, prints the times in usec
+ *    -n names    Event names, an "id name" per line, id in C notation
+ *    file        The raw records, stdin if omitted
+ *
+ *    The records are in the target's byte order. Little endian targets
+ *    decode as they are on little endian hosts.
+ *
+ *
+ * Copyright (C) 2016 Choutouridis Christos (http://www.houtouridis.net)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <usystrace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define  _NAMES_MAX     (256)
+#define  _NAME_SIZE     (32)
+
+static struct {
+   uint16_t id;
+   char     name[_NAME_SIZE];
+} _names[_NAMES_MAX];
+static int _names_n;
+
+/*!
+ * \brief
+ *    Load the event names file
+ * \return  0 on success, -1 if it can not be opened
+ */
+static int _names_load (const char *path)
+{
+   FILE *f = fopen (path, "r");
+   char line[128], *end;
+   unsigned long id;
+
+   if (!f)
+      return -1;
+   while (_names_n < _NAMES_MAX && fgets (line, sizeof (line), f)) {
+      id = strtoul (line, &end, 0);
+      if (end == line)
+         continue;      // Comment or empty line
+      if (sscanf (end, " %31s", _names[_names_n].name) != 1)
+         continue;
+      _names[_names_n++].id = (uint16_t)id;
+   }
+   fclose (f);
+   return 0;
+}
+
+/*!
+ * \brief
+ *    Name of an event id, NULL if unknown
+ */
+static const char *_name (uint16_t id)
+{
+   int i;
+
+   for (i=0 ; i<_names_n ; ++i)
+      if (_names[i].id == id)
+         return _names[i].name;
+   switch (id) {
+      case USYS_TRACE_ID_SERVICE:   return "service";
+      case USYS_TRACE_ID_LOST:      return "lost";
+      default:                      return NULL;
+   }
+}
+
+/*!
+ * \brief
+ *    Print a time in stamp ticks, or in usec if the frequency is known
+ */
+static void _time (uint64_t t, double freq)
+{
+   if (freq > 0)
+      printf ("%14.3f", (double)t * 1e6 / freq);
+   else
+      printf ("%14llu", (unsigned long long)t);
+}
+
+static void _usage (void)
+{
+   fprintf (stderr, "usage: usys_tracedec [-f freq] [-n names] [file]\n");
+   exit (2);
+}
+
+int main (int argc, char **argv)
+{
+   usys_trace_rec_t r;
+   FILE *in = stdin;
+   double freq = 0;
+   uint64_t t = 0;
+   uint32_t last = 0, seq = 0;
+   const char *n;
+   int i, first = 1;
+
+   for (i=1 ; i<argc ; ++i) {
+      if (!strcmp (argv[i], "-f") && i+1 < argc)
+         freq = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-n") && i+1 < argc) {
+         if (_names_load (argv[++i]) < 0) {
+            perror (argv[i]);
+            return 1;
+         }
+      }
+      else if (argv[i][0] == '-')
+         _usage ();
+      else if (!(in = fopen (argv[i], "rb"))) {
+         perror (argv[i]);
+         return 1;
+      }
+   }
+
+   printf ("%10s %14s %14s  %-16s %s\n", "seq", "time", "delta", "event", "arg");
+   while (fread (&r, sizeof (r), 1, in) == 1) {
+      if (r.id == USYS_TRACE_ID_LOST) {
+         printf ("%10s  -- %lu records lost --\n", "", (unsigned long)r.arg);
+         seq = r.seq;
+         continue;
+      }
+      if (!first && r.seq != seq + 1)
+         printf ("%10s  -- gap of %ld records --\n", "", (long)(r.seq - seq - 1));
+      if (first)
+         last = r.stamp;
+      t += (uint32_t)(r.stamp - last);   // Unwraps the 32 bit stamp
+      printf ("%10lu ", (unsigned long)r.seq);
+      _time (t, freq);
+      printf (" ");
+      _time ((uint32_t)(r.stamp - last), freq);
+      if ((n = _name (r.id)))
+         printf ("  %-16s", n);
+      else
+         printf ("  0x%04x          ", r.id);
+      printf (" 0x%08lx\n", (unsigned long)r.arg);
+      last = r.stamp;
+      seq = r.seq;
+      first = 0;
+   }
+   if (in != stdin)
+      fclose (in);
+   return 0;
+}